@@ -77,6 +77,41 @@ int find_lone_pair(short* str)
   return -1;
 }
 
+// compute Arrhenius rates (as A method in treekin) for given kT for rows from..to-1, rates[(i-from)*num+j] is rate i->j
+void compute_rates(double _kT, int num, float *energy_barr, vector<int> &output_en, double *rates, int from, int to)
+{
+  if (to<0) to = num;
+  #pragma omp parallel for schedule(static)
+  for (int i=from; i<to; i++) {
+    double en_i = output_en[i]/100.0;
+    double *row = rates+(size_t)(i-from)*num;
+    float *barr = energy_barr+(size_t)i*num;
+    for (int j=0; j<num; j++) {
+      row[j] = exp(-(barr[j]-en_i)/_kT);
+    }
+    row[i] = 0.0;
+  }
+}
+
+// write the rate matrix for given kT block by block (only a few rows are in memory at once)
+static void write_rates(FILE *rates, double _kT, int num, float *energy_barr, vector<int> &output_en)
+{
+  int block = max(1, min(num, RATES_BLOCK/max(num, 1)));
+  double *res = (double*) malloc((size_t)block*num*sizeof(double));
+  for (int from=0; from<num; from+=block) {
+    int to = min(num, from+block);
+    compute_rates(_kT, num, energy_barr, output_en, res, from, to);
+    for (int i=from; i<to; i++) {
+      double *row = res+(size_t)(i-from)*num;
+      for (int j=0; j<num; j++) {
+        fprintf(rates, "%10.4g ", (float)row[j]);
+      }
+      fprintf(rates, "\n");
+    }
+  }
+  free(res);
+}
+
 // print rates to a file
 void print_rates(char *filename, double temp, int num, float *energy_barr, vector<int> &output_en, bool only_saddles)
 {
@@ -86,20 +121,101 @@ void print_rates(char *filename, double temp, int num, float *energy_barr, vecto
     fprintf(stderr, "ERROR: couldn't open file \"%s\" for rates! (using stderr instead)\n", filename);
     rates = stderr;
   }
+  if (only_saddles) {
+    for (int i=0; i<num; i++) {
+      for (int j=0; j<num; j++) {
+        fprintf(rates, "%6.2f ", i==j?output_en[i]/100.0:energy_barr[i*num+j]);
+      }
+      fprintf(rates, "\n");
+    }
+  } else {
+    write_rates(rates, 0.00198717*(273.15 + temp), num, energy_barr, output_en);
+  }
+  if (rates!=stderr) fclose(rates);
+}
+
+// print rates for more temperatures (or kT values if kT is set) from one saddle computation, one file per value
+void print_rates_multi(char *filename, int count, double *values, bool kT, int num, float *energy_barr, vector<int> &output_en)
+{
+  char *name = (char*) malloc(strlen(filename)+64);
+  for (int k=0; k<count; k++) {
+    if (kT) sprintf(name, "%s.kT%g", filename, values[k]);
+    else    sprintf(name, "%s.T%g", filename, values[k]);
+
+    FILE *rates = fopen(name, "w");
+    if (rates==NULL) {
+      fprintf(stderr, "ERROR: couldn't open file \"%s\" for rates! (skipping it)\n", name);
+      continue;
+    }
+    write_rates(rates, kT ? values[k] : 0.00198717*(273.15 + values[k]), num, energy_barr, output_en);
+    fclose(rates);
+  }
+  free(name);
+}
+
+// print rates in sparse binary (CSR) format, only for computed saddles
+bool print_rates_bin(char *filename, double temp, int num, float *energy_barr, vector<int> &output_en)
+{
+  FILE *rates;
+  rates = fopen(filename, "wb");
+  if (rates==NULL) {
+    fprintf(stderr, "ERROR: couldn't open file \"%s\" for binary rates!\n", filename);
+    return false;
+  }
+  // big buffer - we write in large chunks anyway
+  setvbuf(rates, NULL, _IOFBF, 1<<20);
+
   double _kT = 0.00198717*(273.15 + temp);
+
+  // first pass - count nonzeros in rows
+  vector<int64_t> row_ptr(num+1, 0);
   for (int i=0; i<num; i++) {
+    int64_t cnt = 0;
+    float *barr = energy_barr+(size_t)i*num;
     for (int j=0; j<num; j++) {
-      float res = 0.0;
-      if (i!=j) {
-        // Arhenius kinetics (as A method in treekin)
-        res = 1.0*exp(-(energy_barr[i*num+j]-(output_en[i]/100.0))/_kT);
-      }
-      if (only_saddles) fprintf(rates, "%6.2f ", i==j?output_en[i]/100.0:energy_barr[i*num+j]);
-      else              fprintf(rates, "%10.4g ", res);
+      if (i!=j && barr[j]<RATES_NO_SADDLE) cnt++;
+    }
+    row_ptr[i+1] = row_ptr[i] + cnt;
+  }
+
+  // header
+  rates_bin_header head;
+  memcpy(head.magic, RATES_BIN_MAGIC, 8);
+  head.version = RATES_BIN_VERSION;
+  head.num = num;
+  head.nnz = row_ptr[num];
+  head.temp = temp;
+  head.kT = _kT;
+  fwrite(&head, sizeof(rates_bin_header), 1, rates);
+  fwrite(&row_ptr[0], sizeof(int64_t), num+1, rates);
+
+  // second pass - column indices, row by row
+  vector<int32_t> cols; cols.reserve(num);
+  for (int i=0; i<num; i++) {
+    cols.clear();
+    float *barr = energy_barr+(size_t)i*num;
+    for (int j=0; j<num; j++) {
+      if (i!=j && barr[j]<RATES_NO_SADDLE) cols.push_back(j);
     }
-    fprintf(rates, "\n");
+    if (!cols.empty()) fwrite(&cols[0], sizeof(int32_t), cols.size(), rates);
   }
-  fclose(rates);
+
+  // third pass - rates, row by row
+  vector<double> vals; vals.reserve(num);
+  for (int i=0; i<num; i++) {
+    vals.clear();
+    double en_i = output_en[i]/100.0;
+    float *barr = energy_barr+(size_t)i*num;
+    for (int j=0; j<num; j++) {
+      if (i!=j && barr[j]<RATES_NO_SADDLE) vals.push_back(exp(-(barr[j]-en_i)/_kT));
+    }
+    if (!vals.empty()) fwrite(&vals[0], sizeof(double), vals.size(), rates);
+  }
+
+  bool ok = !ferror(rates);
+  ok = (fclose(rates) == 0) && ok;
+  if (!ok) fprintf(stderr, "ERROR: couldn't write binary rates \"%s\"!\n", filename);
+  return ok;
 }
 
 // pt to str
@@ -116,40 +232,49 @@ string pt_to_str(short *pt)
   return str;
 }
 
-// encapsulation -- returns energy of the minimum, in case of -N it returns length of the gradient walk.
-int move_set(struct_en &input, SeqInfo &sqi)
+// encapsulation -- returns energy of the minimum, the number of moves goes to *length (-1 for walks with pknots).
+//  input.energy has to be the energy of input.structure (it is not evaluated again)
+int move_set(struct_en &input, SeqInfo &sqi, const WalkOpts &wo, int *length)
 {
   // call the coresponding method
-  int verbose = (Opt.verbose_lvl-2<0?0:Opt.verbose_lvl-2);
-  if (Opt.pknots && Contains_PK(input.structure)) {
-    MOVE_TYPE mt = Opt.rand?ADAPTIVE:Opt.first?FIRST:GRADIENT;
-    Structure str(sqi.seq, input.structure, sqi.s0, sqi.s1);
-    input.energy = move_standard_pk_pt(sqi.seq, &str, sqi.s0, sqi.s1, mt, Opt.shift, Opt.verbose_lvl);
+  int verbose = (wo.verbose-2<0?0:wo.verbose-2);
+  int steps = -1;
+  if (wo.pknots && Contains_PK(input.structure)) {
+    MOVE_TYPE mt = wo.rand?ADAPTIVE:wo.first?FIRST:GRADIENT;
+    Structure str(input.structure, input.energy);
+    // bpairs outside of the pknot model are not inserted - then the energy has to be evaluated anew
+    if (input.energy == INT_MAX || memcmp(str.str, input.structure, sizeof(short)*(input.structure[0]+1))!=0) {
+      str.energy = energy_of_struct_pk(sqi.seq, str.str, sqi.s0, sqi.s1, 0);
+    }
+    input.energy = move_standard_pk_pt(sqi.seq, &str, sqi.s0, sqi.s1, sqi.pairs, mt, wo.shift, wo.verbose);
     copy_arr(input.structure, str.str);
   } else {
-    if (Opt.neighs) {
-      Neighborhood neigh(sqi.seq, sqi.s0, sqi.s1, input.structure);
+    if (wo.neighs) {
+      Neighborhood neigh(sqi.seq, sqi.s0, sqi.s1, sqi.pairs, input.structure);
       Neighborhood::debug = verbose;
-      int length = 0;
-      if (Opt.rand) while (neigh.MoveRandom());
-      else while (neigh.MoveLowest(Opt.first)) length++;
+      steps = 0;
+      if (wo.rand) while (neigh.MoveRandom()) steps++;
+      else while (neigh.MoveLowest(wo.first)) steps++;
 
       // testing:
       //hash_eq heq;
-      //input.energy = move_gradient(sqi.seq, input.structure, sqi.s0, sqi.s1, verbose, Opt.shift, Opt.noLP);
+      //input.energy = move_gradient(sqi.seq, input.structure, sqi.s0, sqi.s1, verbose, wo.shift, wo.noLP);
       //if (neigh.energy != input.energy || !heq(input.structure, neigh.pt)) fprintf(stderr, "UNEQUAL!\n");
 
       copy_arr(input.structure, neigh.pt);
       input.energy = neigh.energy;
-      return length;
     } else {
 
-      if (Opt.rand) input.energy = move_adaptive(sqi.seq, input.structure, sqi.s0, sqi.s1, verbose);
+      // with pknots the energy was computed by energy_of_struct_pk(), walks need energy_of_structure_pt()
+      int energy = wo.pknots ? energy_of_structure_pt(sqi.seq, input.structure, sqi.s0, sqi.s1, 0) : input.energy;
+      if (wo.rand) input.energy = move_adaptive_en(sqi.seq, input.structure, sqi.s0, sqi.s1, sqi.pairs, energy, verbose);
       else {
-        if (Opt.first) input.energy = move_first(sqi.seq, input.structure, sqi.s0, sqi.s1, verbose, Opt.shift, Opt.noLP);
-        else input.energy = move_gradient(sqi.seq, input.structure, sqi.s0, sqi.s1, verbose, Opt.shift, Opt.noLP);
+        if (wo.first) input.energy = move_first_en(sqi.seq, input.structure, sqi.s0, sqi.s1, sqi.pairs, energy, verbose, wo.shift, wo.noLP);
+        else input.energy = move_gradient_en(sqi.seq, input.structure, sqi.s0, sqi.s1, sqi.pairs, energy, verbose, wo.shift, wo.noLP);
       }
+      steps = move_last_steps();
     }
   }
+  if (length) *length = steps;
   return input.energy;
 }
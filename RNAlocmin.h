@@ -3,6 +3,7 @@
 
 #include <string>
 #include <set>
+#include <stdint.h>
 
 #include "globals.h"
 
@@ -21,8 +22,39 @@ int find_lone_pair(short* str);
 // print rates/saddles to a file
 void print_rates(char *filename, double temp, int num, float *energy_barr, std::vector<int> &output_en, bool only_saddles = false);
 
-// just encapsulation
-int move_set(struct_en &input, SeqInfo &sqi);
+// compute Arrhenius rates for given kT of rows from..to-1 (to=-1 means all) into rates array ((to-from)*num)
+void compute_rates(double _kT, int num, float *energy_barr, std::vector<int> &output_en, double *rates, int from = 0, int to = -1);
+
+// rates written to text files are computed in blocks of about this many entries
+#define RATES_BLOCK (1<<20)
+
+// print rates for more temperatures (or kT values) to files "filename.T<temp>" ("filename.kT<kT>")
+void print_rates_multi(char *filename, int count, double *values, bool kT, int num, float *energy_barr, std::vector<int> &output_en);
+
+// sparse binary rates (native endianness):
+//   header (rates_bin_header)
+//   row_ptr: (num+1) x int64 - row i has entries row_ptr[i] .. row_ptr[i+1]-1
+//   col:     nnz x int32     - target minimum of the rate
+//   val:     nnz x double    - rate i->col
+// only pairs with computed saddle are stored (others have rate 0)
+#define RATES_BIN_MAGIC "RLMRATES"
+#define RATES_BIN_VERSION 1
+#define RATES_NO_SADDLE 1e9
+
+struct rates_bin_header {
+  char magic[8];
+  int32_t version;
+  int32_t num;
+  int64_t nnz;
+  double temp;
+  double kT;
+};
+
+// returns false if the file could not be written
+bool print_rates_bin(char *filename, double temp, int num, float *energy_barr, std::vector<int> &output_en);
+
+// just encapsulation (number of moves of the walk goes to *length, -1 for walks with pknots)
+int move_set(struct_en &input, SeqInfo &sqi, const WalkOpts &wo, int *length = NULL);
 
 
 #endif
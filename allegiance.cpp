@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "allegiance.h"
+#include "pknots.h"
+
+using namespace std;
+
+Allegiance::Allegiance()
+{
+  on = false;
+  out = side = NULL;
+  side_name = NULL;
+  len = 0;
+  buffer = NULL;
+}
+
+Allegiance::~Allegiance()
+{
+  if (out) fclose(out);
+  if (side) {
+    fclose(side);
+    remove(side_name);
+  }
+  if (side_name) free(side_name);
+  if (buffer) free(buffer);
+}
+
+bool Allegiance::Open(const char *filename, const char *seq)
+{
+  out = fopen(filename, "w");
+  if (out == NULL) {
+    fprintf(stderr, "ERROR: couldn't open file \"%s\" for allegiance!\n", filename);
+    return false;
+  }
+  side_name = (char*) malloc(strlen(filename)+5);
+  sprintf(side_name, "%s.tmp", filename);
+  side = fopen(side_name, "w+b");
+  if (side == NULL) {
+    fprintf(stderr, "ERROR: couldn't open file \"%s\" for allegiance!\n", side_name);
+    fclose(out);
+    out = NULL;
+    return false;
+  }
+  setvbuf(side, NULL, _IOFBF, 1<<20);
+
+  len = strlen(seq);
+  buffer = (char*) malloc(len+1);
+  fprintf(out, "       %s\n", seq);
+  on = true;
+  return true;
+}
+
+int Allegiance::Id(const short *lm)
+{
+  unordered_map<const short*, int>::iterator it = lm_id.find(lm);
+  if (it != lm_id.end()) return it->second;
+  int id = lm_id.size();
+  lm_id[lm] = id;
+  return id;
+}
+
+void Allegiance::Sample(const struct_en &str, int id)
+{
+  string s = pt_to_str_pk(str.structure);
+  fwrite(&str.energy, sizeof(int), 1, side);
+  fwrite(&id, sizeof(int), 1, side);
+  fwrite(s.c_str(), 1, len, side);
+}
+
+void Allegiance::Number(const short *lm, int num)
+{
+  unordered_map<const short*, int>::iterator it = lm_id.find(lm);
+  if (it == lm_id.end()) return;
+  if ((int)lm_num.size() <= it->second) lm_num.resize(lm_id.size(), 0);
+  lm_num[it->second] = num;
+}
+
+bool Allegiance::Finish()
+{
+  if (!on) return true;
+  on = false;
+  lm_num.resize(lm_id.size(), 0);
+  lm_id.clear();
+
+  bool ok = fflush(side) == 0 && fseek(side, 0, SEEK_SET) == 0;
+  int energy, id;
+  buffer[len] = '\0';
+  for (int i=1; ok && fread(&energy, sizeof(int), 1, side) == 1; i++) {
+    ok = fread(&id, sizeof(int), 1, side) == 1 && fread(buffer, 1, len, side) == (size_t)len;
+    if (ok) fprintf(out, "%6d %s %6.2f %6d\n", i, buffer, energy/100.0, (id >= 0 ? lm_num[id] : 0));
+  }
+  ok = ok && !ferror(side);
+  fclose(side);
+  side = NULL;
+  remove(side_name);
+
+  ok = (fclose(out) == 0) && ok;
+  out = NULL;
+  if (!ok) fprintf(stderr, "ERROR: couldn't write allegiance!\n");
+  return ok;
+}
@@ -0,0 +1,45 @@
+#ifndef __ALLEGIANCE_H
+#define __ALLEGIANCE_H
+
+#include <stdio.h>
+
+#include <vector>
+#include <unordered_map>
+
+#include "hash_util.h"
+
+// allegiance of samples to minima (--allegiance), streamed: samples go into a binary side file "<file>.tmp" as they are walked
+//  (energy, id of the minimum in order of discovery, structure), ids are remapped to numbers of minima in output at the end
+//  minima are identified by their structure in output (the pointer), so they must not be freed while sampling (no --bounded)
+class Allegiance {
+public:
+  bool on;
+
+private:
+  FILE *out;
+  FILE *side;
+  char *side_name;
+  int len;
+  std::unordered_map<const short*, int> lm_id;  // minimum -> id
+  std::vector<int> lm_num;                      // id -> number in output (0 = not in output)
+  char *buffer;
+
+public:
+  Allegiance();
+  ~Allegiance();
+
+  // open output (header with sequence) and side file, returns false on error
+  bool Open(const char *filename, const char *seq);
+
+  // id of minimum lm (structure of its key in output)
+  int Id(const short *lm);
+  // write sample str that walked into minimum id (-1 = none: lone pairs, outside of pknot model)
+  void Sample(const struct_en &str, int id);
+  // number (from 1) of minimum lm in output
+  void Number(const short *lm, int num);
+
+  // final pass: write samples with numbers of their minima, returns false on error
+  bool Finish();
+};
+
+#endif
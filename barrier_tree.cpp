@@ -1,6 +1,10 @@
 #include <stdio.h>
 
-#include <queue>
+#include <vector>
+#include <algorithm>
+#ifdef _OPENMP
+  #include <parallel/algorithm>
+#endif
 
 #include "barrier_tree.h"
 
@@ -16,130 +20,127 @@ typedef struct {
 struct comparator {
   bool operator()(const energy_pair& x, const energy_pair& y) const {
     if (x.barrier==y.barrier) {
-      if (x.findpath != y.findpath) return x.findpath;  // findpath==false - go first!
-      if (x.i == y.i) return x.j > y.j;
-      else return x.i > y.i;
+      if (x.findpath != y.findpath) return y.findpath;  // findpath==false - go first!
+      if (x.i == y.i) return x.j < y.j;
+      else return x.i < y.i;
     }
-    return x.barrier > y.barrier;
+    return x.barrier < y.barrier;
   }
 };
 
-// union-find set array
-vector<int> parent;
-//unsigned int num_unions = 0;
+// ===================== UNION-FIND ====================
 
-// ===================== LOCAL FUNCTIONS ====================
-
-// and union-find set functions
-int find(int x) {
-  if (x != parent[x] && parent[x] != parent[parent[x]])
-    parent[x] = find(parent[x]);
-  return parent[x];
+UnionFind::UnionFind(int n):parent(n), rank_uf(n, 0), label(n)
+{
+  for (int i=0; i<n; i++) parent[i]=label[i]=i;
 }
 
-void union_set(int father, int child) {
-  int u, v;
-  u = find(father);
-  v = find(child);
-  if (u != v) {
-    parent[max(v, u)] = min(v, u);
-    //num_unions++;
+// root of the set with path compression
+int UnionFind::Root(int x) {
+  int root = x;
+  while (parent[root] != root) root = parent[root];
+  while (parent[x] != root) {
+    int next = parent[x];
+    parent[x] = root;
+    x = next;
   }
+  return root;
 }
 
-bool joint(int x, int y) {
-  return find(x) == find(y);
+int UnionFind::Find(int x) {
+  return label[Root(x)];
 }
 
-void init_union(int n) {
-  parent.resize(n);
-  for (int i=0; i<n; i++) parent[i]=i;
+void UnionFind::Union(int father, int child) {
+  int u, v;
+  u = Root(father);
+  v = Root(child);
+  if (u != v) {
+    // union by rank, keep the lowest label
+    int lab = min(label[u], label[v]);
+    if (rank_uf[u] < rank_uf[v]) swap(u, v);
+    parent[v] = u;
+    if (rank_uf[u] == rank_uf[v]) rank_uf[u]++;
+    label[u] = lab;
+  }
 }
 
-// find father of node i (uncomputed -> return i)
-int findfather(nodeT *nodes, int i) {
-  if (nodes[i].father == -1) return i;
-  else return findfather(nodes, nodes[i].father);
+bool UnionFind::Joint(int x, int y) {
+  return Root(x) == Root(y);
 }
 
 // make barrier tree
 int make_tree(int n, float *energy_barr, bool *findpath, nodeT *nodes)
 {
-  priority_queue<energy_pair, vector<energy_pair>, comparator> saddles;
+  // flat array of saddles (filled in parallel per rows)
+  vector<int> row_start(n+1, 0);
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (int i=0; i<n; i++) {
+    int cnt = 0;
+    for (int j=i+1; j<n; j++) {
+      if (energy_barr[i*n+j]<1e8) cnt++;
+    }
+    row_start[i+1] = cnt;
+  }
+  for (int i=0; i<n; i++) row_start[i+1] += row_start[i];
+
+  vector<energy_pair> saddles(row_start[n]);
+  #pragma omp parallel for schedule(dynamic, 64)
   for (int i=0; i<n; i++) {
-    //if (nodes[i].father!=-1) continue;
+    int pos = row_start[i];
     for (int j=i+1; j<n; j++) {
-      //if (nodes[j].father!=-1) continue;
       if (energy_barr[i*n+j]<1e8) {
-        energy_pair ep;
+        energy_pair &ep = saddles[pos++];
         ep.barrier = energy_barr[i*n+j];
         ep.i=i;
         ep.j=j;
         ep.findpath=findpath[i*n+j];
-        saddles.push(ep);
       }
     }
   }
 
+#ifdef _OPENMP
+  __gnu_parallel::sort(saddles.begin(), saddles.end(), comparator());
+#else
+  sort(saddles.begin(), saddles.end(), comparator());
+#endif
+
   // max_height
   float max_height = -1e10;
-  //for (int i=0; i<n; i++) if (nodes[i].father!=-1) max_height=max(max_height, nodes[i].saddle_height);
-
-  // compute all except one nodes
-  /*while (!saddles.empty()) {
-    energy_pair ep = saddles.top();
-    saddles.pop();
-
-    // if not already computed
-    int fatheri = findfather(nodes, ep.i);
-    int fatherj = findfather(nodes, ep.j);
-    if (fatheri != fatherj) {
-      // merge i and j by their fathers
-      if (fatheri>fatherj) swap(fatheri, fatherj);
-      nodes[fatherj].saddle_height = ep.barrier;
-      add_father(nodes, fatherj, fatheri, 0.5);
-      //nodes[fatherj].father = fatheri;
-      if (ep.barrier>max_height) max_height = ep.barrier;
-    }
-  }*/
 
-  float energy = 1e10;
-  set<std::pair<int, int> > degen_set;
+  // Kruskal over sorted saddles, saddles with equal energy are processed as one group
+  UnionFind uf(n);
+  vector<int> degen_children;
+  for (unsigned int k=0; k<saddles.size(); ) {
+    unsigned int end = k;
+    while (end<saddles.size() && saddles[end].barrier == saddles[k].barrier) end++;
 
-  init_union(n);
-  while (!saddles.empty()) {
-    energy_pair ep = saddles.top();
-    saddles.pop();
+    degen_children.clear();
+    for (; k<end; k++) {
+      energy_pair &ep = saddles[k];
+      if (uf.Joint(ep.i, ep.j)) continue;
 
-    if (!joint(ep.i, ep.j)) {
-
-      int i=find(ep.i);
-      int j=find(ep.j);
+      int i=uf.Find(ep.i);
+      int j=uf.Find(ep.j);
 
       int father = min(i, j);
       int child = max(i, j);
 
-      // degeneracy :/
-      if (energy != ep.barrier) {
-        degen_set.clear();
-      } else {
-        for (set<std::pair<int, int> >::iterator it=degen_set.begin(); it!=degen_set.end(); it++) {
-          // if last father equals this child - change that father
-          if (it->first == child) nodes[it->second].father = father;
-        }
-      }
-      energy = ep.barrier;
-      degen_set.insert(make_pair(father, child));
-
       //fprintf(stderr, "joining: (%2d)%2d (%2d)%2d f%2d ch%2d %6.2f %c\n", ep.i, i, ep.j, j, father, child, ep.barrier, ep.findpath?'#':' ');
       nodes[child].father = father;
       nodes[child].saddle_height = ep.barrier;
       nodes[child].color = (ep.findpath?0.5:0.0);
+      degen_children.push_back(child);
 
       if (ep.barrier>max_height) max_height = ep.barrier;
 
       // finally join them
-      union_set(father, child);
+      uf.Union(father, child);
+    }
+
+    // degeneracy - all minima joined at this height hang on the lowest one
+    for (unsigned int l=0; l<degen_children.size(); l++) {
+      nodes[degen_children[l]].father = uf.Find(degen_children[l]);
     }
   }
 
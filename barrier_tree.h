@@ -1,10 +1,23 @@
+#include <vector>
+
 #include "treeplot.h"
 
 
-// union find set for LM when trying to recompute barrier tree
-void union_set(int father, int child);
-void init_union(int n);
-int find(int x);
+// union find set for LM when trying to recompute barrier tree (label of a set = lowest LM in it - it is returned by Find())
+class UnionFind {
+  std::vector<int> parent;
+  std::vector<int> rank_uf;
+  std::vector<int> label;
+
+  int Root(int x);
+
+public:
+  UnionFind(int n);
+
+  int Find(int x);
+  void Union(int father, int child);
+  bool Joint(int x, int y);
+};
 
 // make barrier tree
 int make_tree(int n, float *energy_bar, bool *findpath, nodeT *nodes);
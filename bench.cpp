@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+#include "librnalocmin.h"
+#include "RNAlocmin.h"
+#include "pknots.h"
+#include "run_stats.h"
+#include "bench_util.h"
+
+using namespace std;
+
+// benchmark driver (make bench) - reproducible random sequences and structures, so RNAsubopt is not needed
+//  usage: RNAlocmin_bench [-o results.tsv] [-c previous.tsv] [-l 50,100,...] [-n structures] [-t seconds] [-s seed]
+//  results are tab separated lines "benchmark length variant ops secs ops_per_sec",
+//  with -c the rates are compared to a previous results file (same seed and lengths give the same workload)
+
+// one measured benchmark
+struct BenchRow {
+  string bench;
+  int length;         // sequence length (number of minima for tree)
+  string variant;
+  long long ops;
+  double secs;
+};
+
+static vector<BenchRow> rows;
+static double min_time = 1.0;  // each benchmark runs at least this long (and at least once)
+static const int flood_max = 1000;  // as default --floodMax
+
+static void add_row(const char *bench, int length, const string &variant, long long ops, double secs)
+{
+  BenchRow r = {bench, length, variant, ops, secs};
+  rows.push_back(r);
+  fprintf(stderr, "%-10s %5d %-12s %10lld ops %8.3f secs %12.2f ops/sec\n", bench, length, variant.c_str(), ops, secs, ops/secs);
+}
+
+// walk methods and move sets (as -w and -m/-N options)
+struct WalkVariant {
+  const char *name;
+  bool first;
+  bool rand;
+  bool shift;
+  bool neighs;
+};
+
+static const WalkVariant walk_variants[] = {
+  {"D-I", false, false, false, false},
+  {"F-I", true,  false, false, false},
+  {"R-I", false, true,  false, false},
+  {"D-S", false, false, true,  false},
+  {"F-S", true,  false, true,  false},
+  {"D-N", false, false, false, true},
+  {"F-N", true,  false, false, true},
+};
+
+static void set_walk(LMContext &ctx, const WalkVariant &wv)
+{
+  ctx.walk.first = wv.first;
+  ctx.walk.rand = wv.rand;
+  ctx.walk.shift = wv.shift;
+  ctx.walk.neighs = wv.neighs;
+}
+
+static void bench_walks(LMContext &ctx, int length, vector<struct_en> &strs)
+{
+  for (unsigned int v=0; v<sizeof(walk_variants)/sizeof(WalkVariant); v++) {
+    set_walk(ctx, walk_variants[v]);
+    long long ops = 0;
+    double start = bench_now(), secs;
+    do {
+      struct_en he = strs[ops%strs.size()];
+      he.structure = allocopy(he.structure);
+      lm_descend(ctx, he);
+      free(he.structure);
+      ops++;
+    } while ((secs = bench_now()-start) < min_time);
+    add_row("walk", length, walk_variants[v].name, ops, secs);
+  }
+  set_walk(ctx, walk_variants[0]);
+
+  // all threads (as --two-phase)
+  long long ops = 0;
+  double start = bench_now(), secs;
+  do {
+    vector<struct_en> lms;
+    lm_descend_all(ctx, strs, lms);
+    for (unsigned int i=0; i<lms.size(); i++) free(lms[i].structure);
+    ops += strs.size();
+  } while ((secs = bench_now()-start) < min_time);
+  int threads = 1;
+#ifdef _OPENMP
+  threads = omp_get_max_threads();
+#endif
+  char variant[20];
+  sprintf(variant, "D-I-x%d", threads);
+  add_row("walk", length, variant, ops, secs);
+}
+
+// floods of the basins of minima (up to --floodMax structures)
+static void bench_flood(LMContext &ctx, int length, vector<struct_en> &minima)
+{
+  RunStats stats;
+  ctx.stats = &stats;
+  long long ops = 0;
+  double start = bench_now(), secs;
+  do {
+    int saddle;
+    struct_en *he = lm_flood(ctx, minima[ops%minima.size()], saddle, flood_max);
+    if (he) {
+      free(he->structure);
+      free(he);
+    }
+    ops++;
+  } while ((secs = bench_now()-start) < min_time);
+  ctx.stats = NULL;
+
+  long long expanded = 0;
+  for (map<int, long long>::iterator it=stats.flood_size.begin(); it!=stats.flood_size.end(); it++) {
+    expanded += it->first*it->second;
+  }
+  add_row("flood", length, "floods", ops, secs);
+  add_row("flood", length, "expansions", expanded, secs);
+}
+
+// findpath between neighbouring minima (by energy)
+static void bench_findpath(LMContext &ctx, int length, vector<struct_en> &minima, int depth)
+{
+  int num = minima.size();
+  vector<string> strs(num);
+  for (int i=0; i<num; i++) strs[i] = pt_to_str_pk(minima[i].structure);
+
+  long long ops = 0;
+  double start = bench_now(), secs;
+  do {
+    int i = ops%(num-1);
+    lm_saddle(ctx, strs[i].c_str(), strs[i+1].c_str(), depth);
+    ops++;
+  } while ((secs = bench_now()-start) < min_time);
+  char variant[20];
+  sprintf(variant, "depth%d", depth);
+  add_row("findpath", length, variant, ops, secs);
+}
+
+// barrier tree from random saddles between num minima (all pairs known)
+static void bench_tree(BenchRng &rng, int num)
+{
+  vector<int> energies(num);
+  for (int i=0; i<num; i++) energies[i] = -3000 + rng.Int(3000);
+  sort(energies.begin(), energies.end());
+
+  float *energy_barr = (float*) malloc(num*num*sizeof(float));
+  bool *findpath_barr = (bool*) malloc(num*num*sizeof(bool));
+  for (int i=0; i<num; i++) {
+    energy_barr[i*num+i] = 1e10;
+    findpath_barr[i*num+i] = false;
+    for (int j=i+1; j<num; j++) {
+      energy_barr[i*num+j] = energy_barr[j*num+i] = energies[j]/100.0 + rng.Int(1000)/100.0;
+      findpath_barr[i*num+j] = findpath_barr[j*num+i] = true;
+    }
+  }
+
+  vector<nodeT> nodes(num);
+  long long ops = 0;
+  double start = bench_now(), secs;
+  do {
+    lm_tree(num, energy_barr, findpath_barr, energies, &nodes[0]);
+    ops++;
+  } while ((secs = bench_now()-start) < min_time);
+  add_row("tree", num, "all-pairs", ops, secs);
+
+  free(energy_barr);
+  free(findpath_barr);
+}
+
+// write results, returns false on error
+static bool write_results(FILE *f, unsigned int seed)
+{
+  int threads = 1;
+#ifdef _OPENMP
+  threads = omp_get_max_threads();
+#endif
+  fprintf(f, "# RNAlocmin benchmark: seed %u, threads %d, min. time %.2f secs\n", seed, threads, min_time);
+  fprintf(f, "# benchmark\tlength\tvariant\tops\tsecs\tops_per_sec\n");
+  for (unsigned int i=0; i<rows.size(); i++) {
+    BenchRow &r = rows[i];
+    fprintf(f, "%s\t%d\t%s\t%lld\t%.6f\t%.3f\n", r.bench.c_str(), r.length, r.variant.c_str(), r.ops, r.secs, r.ops/r.secs);
+  }
+  return !ferror(f);
+}
+
+// compare with a previous results file (speedup = new rate / old rate)
+static bool compare_results(const char *filename)
+{
+  FILE *f = fopen(filename, "r");
+  if (f == NULL) {
+    fprintf(stderr, "ERROR: Cannot open previous results \"%s\".\n", filename);
+    return false;
+  }
+  map<string, double> old;
+  char *line;
+  while ((line = my_getline(f)) != NULL) {
+    char bench[100], variant[100];
+    int length;
+    long long ops;
+    double secs, rate;
+    if (line[0] != '#' && sscanf(line, "%99s %d %99s %lld %lf %lf", bench, &length, variant, &ops, &secs, &rate) == 6) {
+      char key[250];
+      sprintf(key, "%s %d %s", bench, length, variant);
+      old[key] = rate;
+    }
+    free(line);
+  }
+  fclose(f);
+
+  printf("%-10s %6s %-12s %14s %14s %8s\n", "benchmark", "length", "variant", "old ops/sec", "new ops/sec", "speedup");
+  for (unsigned int i=0; i<rows.size(); i++) {
+    BenchRow &r = rows[i];
+    char key[250];
+    sprintf(key, "%s %d %s", r.bench.c_str(), r.length, r.variant.c_str());
+    map<string, double>::iterator it = old.find(key);
+    if (it == old.end()) printf("%-10s %6d %-12s %14s %14.2f %8s\n", r.bench.c_str(), r.length, r.variant.c_str(), "-", r.ops/r.secs, "-");
+    else printf("%-10s %6d %-12s %14.2f %14.2f %8.3f\n", r.bench.c_str(), r.length, r.variant.c_str(), it->second, r.ops/r.secs, (r.ops/r.secs)/it->second);
+  }
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  const char *out_file = NULL;
+  const char *cmp_file = NULL;
+  unsigned int seed = 1;
+  int num_structs = 100;
+  vector<int> lengths;
+  int tree_sizes[] = {100, 500, 1000, 2000, 5000};
+
+  for (int i=1; i<argc; i++) {
+    if (!strcmp(argv[i], "-o") && i+1<argc) out_file = argv[++i];
+    else if (!strcmp(argv[i], "-c") && i+1<argc) cmp_file = argv[++i];
+    else if (!strcmp(argv[i], "-s") && i+1<argc) seed = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-n") && i+1<argc) num_structs = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-t") && i+1<argc) min_time = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-l") && i+1<argc) bench_list(argv[++i], lengths);
+    else {
+      fprintf(stderr, "usage: %s [-o results.tsv] [-c previous.tsv] [-l 50,100,...] [-n structures] [-t seconds] [-s seed]\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (lengths.empty()) {
+    int def[] = {50, 100, 200, 500, 1000, 2000};
+    lengths.assign(def, def+sizeof(def)/sizeof(int));
+  }
+  if (num_structs < 2 || min_time < 0) {
+    fprintf(stderr, "ERROR: bad number of structures or time.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  for (unsigned int l=0; l<lengths.size(); l++) {
+    if (lengths[l] < 10) continue;
+    // every length has its own random stream (results do not depend on the other lengths)
+    BenchRng rng(seed*100003ULL + lengths[l]);
+    string seq = random_seq(rng, lengths[l]);
+    LMContext ctx(seq.c_str());
+
+    vector<struct_en> strs;
+    random_structs(rng, ctx, seq, num_structs, strs);
+    bench_walks(ctx, lengths[l], strs);
+
+    // minima for flooding and findpath (gradient descent)
+    vector<struct_en> lms;
+    lm_descend_all(ctx, strs, lms);
+    set<struct_en, comps_entries> uniq;
+    for (unsigned int i=0; i<lms.size(); i++) {
+      if (lms[i].structure && !uniq.insert(lms[i]).second) free(lms[i].structure);
+    }
+    vector<struct_en> minima(uniq.begin(), uniq.end());
+    if (minima.size() >= 2) {
+      bench_flood(ctx, lengths[l], minima);
+      bench_findpath(ctx, lengths[l], minima, 10);
+    }
+
+    for (unsigned int i=0; i<minima.size(); i++) free(minima[i].structure);
+    for (unsigned int i=0; i<strs.size(); i++) free(strs[i].structure);
+  }
+
+  BenchRng rng(seed);
+  for (unsigned int i=0; i<sizeof(tree_sizes)/sizeof(int); i++) bench_tree(rng, tree_sizes[i]);
+
+  // results
+  bool ok = true;
+  if (out_file) {
+    FILE *f = fopen(out_file, "w");
+    if (f == NULL) {
+      fprintf(stderr, "ERROR: couldn't open file \"%s\" for results!\n", out_file);
+      exit(EXIT_FAILURE);
+    }
+    ok = write_results(f, seed);
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) fprintf(stderr, "ERROR: couldn't write results \"%s\"!\n", out_file);
+  } else if (!cmp_file) {
+    ok = write_results(stdout, seed);
+  }
+  if (cmp_file) ok = compare_results(cmp_file) && ok;
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
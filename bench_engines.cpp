@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "librnalocmin.h"
+#include "RNAlocmin.h"
+#include "move_set_pk.h"
+#include "neighbourhood.h"
+#include "profile.h"
+#include "bench_util.h"
+
+using namespace std;
+
+// head to head comparison of the gradient walk engines (make bench-engines) on the same random pseudoknot-free structures:
+//  inside        - move_gradient_en() from move_set_inside.c (default)
+//  neighborhood  - Neighborhood::MoveLowest() (-N)
+//  pk            - move_gradient_pk() (-k, pseudoknot move set)
+//  usage: RNAlocmin_engines [-o results.tsv] [-l 50,100,...] [-n structures] [-s seed]
+//  reports per step latency, energy evaluations (move deltas, only with -DPROFILE) and allocations per step,
+//  exits with 1 if the engines do not end in the same minimum (the pk engine may end in a pseudoknot, that is counted apart)
+
+// allocations (glibc only - malloc is replaced here, the original is called)
+#ifdef __GLIBC__
+extern "C" {
+  void *__libc_malloc(size_t size);
+  void *__libc_calloc(size_t num, size_t size);
+  void *__libc_realloc(void *ptr, size_t size);
+}
+static bool count_allocs = false;
+static long long allocs = 0;
+
+extern "C" void *malloc(size_t size)
+{
+  if (count_allocs) allocs++;
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t num, size_t size)
+{
+  if (count_allocs) allocs++;
+  return __libc_calloc(num, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+  if (count_allocs) allocs++;
+  return __libc_realloc(ptr, size);
+}
+#endif
+
+enum ENGINE {EN_INSIDE, EN_NEIGHBORHOOD, EN_PK, EN_NUM};
+static const char engine_name[EN_NUM][15] = {"inside", "neighborhood", "pk"};
+
+// totals of one engine on one length
+struct EngineRow {
+  int length;
+  int engine;
+  int walks;
+  long long steps;
+  double secs;
+  long long evals;     // -1 if not counted
+  long long allocs;    // -1 if not counted
+  int mismatches;      // walks ending elsewhere than the inside engine
+  int pknots;          // walks ending in a pseudoknot (pk engine)
+};
+
+// one walk of engine from he (not changed), the minimum goes to lm (to be freed), returns number of steps
+static int walk(int engine, LMContext &ctx, const struct_en &he, struct_en &lm)
+{
+  SeqInfo &sqi = ctx.sqi;
+  int steps = 0;
+  switch (engine) {
+    case EN_INSIDE: {
+      lm.structure = allocopy(he.structure);
+      lm.energy = move_gradient_en(sqi.seq, lm.structure, sqi.s0, sqi.s1, sqi.pairs, he.energy, 0, 0, 0);
+      steps = move_last_steps();
+      break;
+    }
+    case EN_NEIGHBORHOOD: {
+      Neighborhood neigh(sqi.seq, sqi.s0, sqi.s1, sqi.pairs, he.structure);
+      while (neigh.MoveLowest(false)) steps++;
+      lm.structure = allocopy(neigh.pt);
+      lm.energy = neigh.energy;
+      break;
+    }
+    case EN_PK: {
+      Structure str(he.structure, he.energy);
+      lm.energy = move_gradient_pk(sqi.seq, &str, sqi.s0, sqi.s1, sqi.pairs, 0, 0);
+      lm.structure = allocopy(str.str);
+      steps = count_move()-1;
+      break;
+    }
+  }
+  return steps;
+}
+
+int main(int argc, char **argv)
+{
+  const char *out_file = NULL;
+  unsigned int seed = 1;
+  int num_structs = 100;
+  vector<int> lengths;
+
+  for (int i=1; i<argc; i++) {
+    if (!strcmp(argv[i], "-o") && i+1<argc) out_file = argv[++i];
+    else if (!strcmp(argv[i], "-s") && i+1<argc) seed = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-n") && i+1<argc) num_structs = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-l") && i+1<argc) bench_list(argv[++i], lengths);
+    else {
+      fprintf(stderr, "usage: %s [-o results.tsv] [-l 50,100,...] [-n structures] [-s seed]\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (lengths.empty()) {
+    int def[] = {50, 100, 200, 500, 1000};
+    lengths.assign(def, def+sizeof(def)/sizeof(int));
+  }
+  if (num_structs < 1) {
+    fprintf(stderr, "ERROR: bad number of structures.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  vector<EngineRow> rows;
+  int mismatches = 0;
+  for (unsigned int l=0; l<lengths.size(); l++) {
+    if (lengths[l] < 10) continue;
+    // same workload as in bench.cpp
+    BenchRng rng(seed*100003ULL + lengths[l]);
+    string seq = random_seq(rng, lengths[l]);
+    LMContext ctx(seq.c_str());
+    vector<struct_en> strs;
+    random_structs(rng, ctx, seq, num_structs, strs);
+
+    // minima of the reference (inside) engine
+    vector<struct_en> ref(strs.size());
+    hash_eq heq;
+    for (int e=0; e<EN_NUM; e++) {
+      EngineRow row = {lengths[l], e, 0, 0, 0.0, -1, -1, 0, 0};
+#ifdef PROFILE
+      long long evals = prof_count(PROF_MOVE);
+#endif
+#ifdef __GLIBC__
+      allocs = 0;
+#endif
+      for (unsigned int i=0; i<strs.size(); i++) {
+        struct_en lm;
+#ifdef __GLIBC__
+        count_allocs = true;
+#endif
+        double start = bench_now();
+        row.steps += walk(e, ctx, strs[i], lm);
+        row.secs += bench_now()-start;
+#ifdef __GLIBC__
+        count_allocs = false;
+#endif
+        row.walks++;
+
+        if (e == EN_INSIDE) {
+          ref[i] = lm;
+          continue;
+        }
+        if (e == EN_PK && Contains_PK(lm.structure)) {
+          row.pknots++;
+        } else if (lm.energy != ref[i].energy || !heq(lm.structure, ref[i].structure)) {
+          row.mismatches++;
+          if (row.mismatches <= 3) {
+            fprintf(stderr, "MISMATCH %s (length %d, structure %d):\n  start  %s %6.2f\n  inside %s %6.2f\n  %-6.6s %s %6.2f\n", engine_name[e], lengths[l], i,
+                    pt_to_str(strs[i].structure).c_str(), strs[i].energy/100.0, pt_to_str(ref[i].structure).c_str(), ref[i].energy/100.0,
+                    engine_name[e], pt_to_str(lm.structure).c_str(), lm.energy/100.0);
+          }
+        }
+        free(lm.structure);
+      }
+#ifdef PROFILE
+      row.evals = prof_count(PROF_MOVE) - evals;
+#endif
+#ifdef __GLIBC__
+      row.allocs = allocs;
+#endif
+      mismatches += row.mismatches;
+      rows.push_back(row);
+    }
+
+    for (unsigned int i=0; i<strs.size(); i++) {
+      free(strs[i].structure);
+      free(ref[i].structure);
+    }
+  }
+
+  // results
+  FILE *f = stdout;
+  if (out_file) {
+    f = fopen(out_file, "w");
+    if (f == NULL) {
+      fprintf(stderr, "ERROR: couldn't open file \"%s\" for results!\n", out_file);
+      exit(EXIT_FAILURE);
+    }
+  }
+  fprintf(f, "# RNAlocmin engines: seed %u, %d structures per length%s\n", seed, num_structs, (rows.empty() || rows[0].evals>=0 ? "" : ", energy evaluations not counted (compile with -DPROFILE)"));
+  fprintf(f, "# length\tengine\twalks\tsteps\tus_per_step\tevals_per_step\tallocs_per_step\tmismatches\tpknots\n");
+  for (unsigned int i=0; i<rows.size(); i++) {
+    EngineRow &r = rows[i];
+    long long steps = (r.steps ? r.steps : 1);
+    fprintf(f, "%d\t%s\t%d\t%lld\t%.3f\t%.2f\t%.2f\t%d\t%d\n", r.length, engine_name[r.engine], r.walks, r.steps, r.secs/steps*1e6,
+            (r.evals<0 ? -1.0 : r.evals/(double)steps), (r.allocs<0 ? -1.0 : r.allocs/(double)steps), r.mismatches, r.pknots);
+  }
+  if (out_file) fclose(f);
+
+  // faster engine per length (time of the whole walk - the engines may need different number of steps)
+  for (unsigned int i=0; i+EN_NUM<=rows.size(); i+=EN_NUM) {
+    int best = i;
+    for (int e=1; e<EN_NUM; e++) {
+      if (rows[i+e].secs < rows[best].secs) best = i+e;
+    }
+    fprintf(stderr, "length %5d: fastest engine %-12s (%.3f ms per walk)\n", rows[i].length, engine_name[rows[best].engine], rows[best].secs/rows[best].walks*1e3);
+  }
+
+  if (mismatches) fprintf(stderr, "ERROR: %d walks ended in different minima!\n", mismatches);
+  return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
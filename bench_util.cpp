@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench_util.h"
+
+using namespace std;
+
+double bench_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static bool can_pair(char a, char b)
+{
+  switch (a) {
+    case 'A': return b=='U';
+    case 'C': return b=='G';
+    case 'G': return b=='C' || b=='U';
+    case 'U': return b=='A' || b=='G';
+  }
+  return false;
+}
+
+string random_seq(BenchRng &rng, int length)
+{
+  const char nt[] = "ACGU";
+  string seq(length, 'A');
+  for (int i=0; i<length; i++) seq[i] = nt[rng.Int(4)];
+  return seq;
+}
+
+// random secondary structure on seq[i-1..j-1] (pair table)
+static void random_pairs(BenchRng &rng, const string &seq, short *pt, int i, int j)
+{
+  vector<int> cand;
+  while (i+4 <= j) {
+    if (rng.Int(10) < 3) {
+      cand.clear();
+      for (int k=i+4; k<=j; k++) {
+        if (can_pair(seq[i-1], seq[k-1])) cand.push_back(k);
+      }
+      if (!cand.empty()) {
+        int k = cand[rng.Int(cand.size())];
+        pt[i] = k;
+        pt[k] = i;
+        random_pairs(rng, seq, pt, i+1, k-1);
+        i = k+1;
+        continue;
+      }
+    }
+    i++;
+  }
+}
+
+void random_structs(BenchRng &rng, LMContext &ctx, const string &seq, int num, vector<struct_en> &strs)
+{
+  int length = seq.size();
+  for (int n=0; n<num; n++) {
+    struct_en he;
+    he.structure = (short*) calloc(length+1, sizeof(short));
+    he.structure[0] = length;
+    random_pairs(rng, seq, he.structure, 1, length);
+    he.energy = lm_energy(ctx, he.structure);
+    strs.push_back(he);
+  }
+}
+
+void bench_list(char *arg, vector<int> &list)
+{
+  char *p = strtok(arg, ",");
+  while (p) {
+    list.push_back(atoi(p));
+    p = strtok(NULL, ",");
+  }
+}
@@ -0,0 +1,38 @@
+#ifndef __BENCH_UTIL_H
+#define __BENCH_UTIL_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "librnalocmin.h"
+
+// reproducible workloads of the benchmark drivers (bench.cpp, bench_engines.cpp)
+
+// xorshift - the same numbers on every platform (unlike rand())
+struct BenchRng {
+  uint64_t s;
+  BenchRng(uint64_t seed) { s = seed*2654435761ULL + 88172645463325252ULL; }
+  uint64_t Next() {
+    s ^= s << 13;
+    s ^= s >> 7;
+    s ^= s << 17;
+    return s;
+  }
+  int Int(int n) { return (int)(Next()%n); }
+};
+
+// monotonic wall time in seconds
+double bench_now();
+
+// random sequence of given length
+std::string random_seq(BenchRng &rng, int length);
+
+// random pseudoknot-free structures with their energies (non-crossing canonical pairs, hairpins at least 3 nt)
+void random_structs(BenchRng &rng, LMContext &ctx, const std::string &seq, int num, std::vector<struct_en> &strs);
+
+// parse comma separated list of numbers (lengths)
+void bench_list(char *arg, std::vector<int> &list);
+
+#endif
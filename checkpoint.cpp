@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include <string>
+#include <map>
+#include <vector>
+#include <unordered_map>
+
+#include "checkpoint.h"
+
+using namespace std;
+
+// file layout (native endianness):
+//   magic (8 chars), version (int), phase (int), sequence length (int), sequence (chars)
+//   CheckpointInfo
+//   sampling: number of minima (int), minima (pair table, energy, hits),
+//             number of walked structures (int), walked structures (pair table, energy, hits, index of minimum or -1 if evicted, energy of minimum)
+//   saddles:  number of minima (int), minima (pair table, energy, hits),
+//             barriers present (int), energy_barr (num*num floats), findpath_barr (num*num bools)
+// pair tables are stored with their length (sequence length + 1 shorts)
+
+static bool write_header(FILE *f, const char *seq, int phase, CheckpointInfo &info)
+{
+  int version = CHECKPOINT_VERSION;
+  int len = strlen(seq);
+  info.phase = phase;
+  fwrite(CHECKPOINT_MAGIC, 1, 8, f);
+  fwrite(&version, sizeof(int), 1, f);
+  fwrite(&phase, sizeof(int), 1, f);
+  fwrite(&len, sizeof(int), 1, f);
+  fwrite(seq, 1, len, f);
+  return fwrite(&info, sizeof(CheckpointInfo), 1, f) == 1;
+}
+
+void write_struct(FILE *f, const struct_en &he, int hits)
+{
+  fwrite(he.structure, sizeof(short), he.structure[0]+1, f);
+  fwrite(&he.energy, sizeof(int), 1, f);
+  fwrite(&hits, sizeof(int), 1, f);
+}
+
+bool read_struct(FILE *f, int len, struct_en &he, int &hits)
+{
+  he.structure = (short*) malloc(sizeof(short)*(len+1));
+  if (fread(he.structure, sizeof(short), len+1, f) != (size_t)len+1 || he.structure[0] != len ||
+      fread(&he.energy, sizeof(int), 1, f) != 1 || fread(&hits, sizeof(int), 1, f) != 1) {
+    free(he.structure);
+    he.structure = NULL;
+    return false;
+  }
+  return true;
+}
+
+// write into filename.tmp and rename it, so a kill during write does not destroy the previous checkpoint
+static FILE *open_tmp(const char *filename, string &tmp)
+{
+  tmp = string(filename) + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+  if (f == NULL) {
+    fprintf(stderr, "ERROR: couldn't open file \"%s\" for checkpoint!\n", tmp.c_str());
+    return NULL;
+  }
+  setvbuf(f, NULL, _IOFBF, 1<<20);
+  return f;
+}
+
+static bool close_tmp(FILE *f, const char *filename, string &tmp)
+{
+  bool ok = !ferror(f);
+  ok = (fclose(f) == 0) && ok;
+  if (!ok || rename(tmp.c_str(), filename) != 0) {
+    fprintf(stderr, "ERROR: couldn't write checkpoint \"%s\"!\n", filename);
+    remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool checkpoint_save_sampling(const char *filename, const char *seq, CheckpointInfo &info, unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> &structs, map<struct_en, int, comps_entries> &output)
+{
+  string tmp;
+  FILE *f = open_tmp(filename, tmp);
+  if (f == NULL) return false;
+  write_header(f, seq, CHK_SAMPLING, info);
+
+  // minima (their order gives indices)
+  int num = output.size();
+  fwrite(&num, sizeof(int), 1, f);
+  map<struct_en, int, comps_entries> index_of;
+  for (map<struct_en, int, comps_entries>::iterator it=output.begin(); it!=output.end(); it++) {
+    write_struct(f, it->first, it->second);
+    index_of.insert(index_of.end(), make_pair(it->first, (int)index_of.size()));
+  }
+
+  // walked structures
+  num = structs.size();
+  fwrite(&num, sizeof(int), 1, f);
+  for (unordered_map<struct_en, gw_struct, hash_fncts, hash_eq>::iterator it=structs.begin(); it!=structs.end(); it++) {
+    write_struct(f, it->first, it->second.count);
+    const struct_en &he = it->second.he;
+    // minima above cutoff of bounded retention are gone (structure is freed), minima evicted before a resume have none
+    int index = -1;
+    if (he.structure != NULL && he.energy <= info.ret_cutoff) {
+      map<struct_en, int, comps_entries>::iterator it_o = index_of.find(he);
+      if (it_o != index_of.end()) index = it_o->second;
+    }
+    fwrite(&index, sizeof(int), 1, f);
+    fwrite(&he.energy, sizeof(int), 1, f);
+  }
+
+  return close_tmp(f, filename, tmp);
+}
+
+bool checkpoint_save_saddles(const char *filename, const char *seq, CheckpointInfo &info, vector<struct_en> &minima, vector<int> &counts, float *energy_barr, bool *findpath_barr)
+{
+  string tmp;
+  FILE *f = open_tmp(filename, tmp);
+  if (f == NULL) return false;
+  write_header(f, seq, CHK_SADDLES, info);
+
+  int num = minima.size();
+  fwrite(&num, sizeof(int), 1, f);
+  for (int i=0; i<num; i++) write_struct(f, minima[i], counts[i]);
+
+  int present = (energy_barr != NULL);
+  fwrite(&present, sizeof(int), 1, f);
+  if (present) {
+    fwrite(energy_barr, sizeof(float), (size_t)num*num, f);
+    fwrite(findpath_barr, sizeof(bool), (size_t)num*num, f);
+  }
+
+  return close_tmp(f, filename, tmp);
+}
+
+// open checkpoint and read its header (up to the sequence), returns NULL on error
+static FILE *open_checkpoint(const char *filename, int &phase, int &len)
+{
+  FILE *f = fopen(filename, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "ERROR: Cannot open checkpoint \"%s\".\n", filename);
+    return NULL;
+  }
+  setvbuf(f, NULL, _IOFBF, 1<<20);
+
+  char magic[8];
+  int version;
+  if (fread(magic, 1, 8, f) != 8 || memcmp(magic, CHECKPOINT_MAGIC, 8) != 0 ||
+      fread(&version, sizeof(int), 1, f) != 1 || version != CHECKPOINT_VERSION ||
+      fread(&phase, sizeof(int), 1, f) != 1 || fread(&len, sizeof(int), 1, f) != 1 || len <= 0) {
+    fprintf(stderr, "ERROR: \"%s\" is not a checkpoint of this version.\n", filename);
+    fclose(f);
+    return NULL;
+  }
+  return f;
+}
+
+char *checkpoint_seq(const char *filename)
+{
+  int phase, len;
+  FILE *f = open_checkpoint(filename, phase, len);
+  if (f == NULL) return NULL;
+  char *seq = (char*) malloc(sizeof(char)*(len+1));
+  seq[len] = '\0';
+  if (fread(seq, 1, len, f) != (size_t)len) {
+    fprintf(stderr, "ERROR: Checkpoint \"%s\" is damaged.\n", filename);
+    free(seq);
+    seq = NULL;
+  }
+  fclose(f);
+  return seq;
+}
+
+char *checkpoint_load(const char *filename, CheckpointInfo &info, unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> &structs, map<struct_en, int, comps_entries> &output,
+                      vector<struct_en> &minima, vector<int> &counts, float *&energy_barr, bool *&findpath_barr)
+{
+  int phase, len;
+  FILE *f = open_checkpoint(filename, phase, len);
+  if (f == NULL) return NULL;
+
+  char *seq = (char*) malloc(sizeof(char)*(len+1));
+  seq[len] = '\0';
+  bool ok = fread(seq, 1, len, f) == (size_t)len && fread(&info, sizeof(CheckpointInfo), 1, f) == 1 && info.phase == phase;
+
+  // minima
+  int num = 0, hits;
+  ok = ok && fread(&num, sizeof(int), 1, f) == 1 && num >= 0;
+  vector<struct_en> lms;
+  for (int i=0; ok && i<num; i++) {
+    struct_en he;
+    ok = read_struct(f, len, he, hits);
+    if (!ok) break;
+    lms.push_back(he);
+    counts.push_back(hits);
+  }
+
+  if (ok && phase == CHK_SAMPLING) {
+    for (int i=0; i<num; i++) output[lms[i]] = counts[i];
+    counts.clear();
+
+    // walked structures
+    int num_s = 0;
+    ok = fread(&num_s, sizeof(int), 1, f) == 1 && num_s >= 0;
+    for (int i=0; ok && i<num_s; i++) {
+      struct_en he;
+      gw_struct gw;
+      int index;
+      ok = read_struct(f, len, he, gw.count) && fread(&index, sizeof(int), 1, f) == 1 && fread(&gw.he.energy, sizeof(int), 1, f) == 1 && index < num;
+      if (!ok) {
+        if (he.structure) free(he.structure);
+        break;
+      }
+      if (index >= 0) gw.he = lms[index];
+      structs[he] = gw;
+    }
+  } else if (ok && phase == CHK_SADDLES) {
+    minima = lms;
+    int present = 0;
+    ok = fread(&present, sizeof(int), 1, f) == 1;
+    if (ok && present) {
+      energy_barr = (float*) malloc((size_t)num*num*sizeof(float));
+      findpath_barr = (bool*) malloc((size_t)num*num*sizeof(bool));
+      ok = fread(energy_barr, sizeof(float), (size_t)num*num, f) == (size_t)num*num && fread(findpath_barr, sizeof(bool), (size_t)num*num, f) == (size_t)num*num;
+    }
+  } else ok = false;
+  fclose(f);
+
+  if (!ok) {
+    fprintf(stderr, "ERROR: Checkpoint \"%s\" is damaged.\n", filename);
+    free(seq);
+    return NULL;
+  }
+  return seq;
+}
@@ -0,0 +1,56 @@
+#ifndef __CHECKPOINT_H
+#define __CHECKPOINT_H
+
+#include <stdio.h>
+
+#include <map>
+#include <vector>
+#include <unordered_map>
+
+#include "hash_util.h"
+
+// checkpoints (--checkpoint, --resume): binary snapshot of a run, written into a temporary file and renamed
+//  sampling phase: position in input, walk hash (structs) with hit counts and minima (output)
+//  saddle phase:   minima (already without the shallow ones) with hits, energy barriers found so far and flooding progress
+#define CHECKPOINT_MAGIC "RLMCHKPT"
+#define CHECKPOINT_VERSION 1
+
+enum CHK_PHASE {CHK_SAMPLING = 1, CHK_SADDLES = 2};
+
+struct CheckpointInfo {
+  int phase;
+  // sampling:
+  long long offset;     // position in stdin (-1 if it cannot be seeked)
+  long long lines;      // lines read from stdin (for input from pipe)
+  int num_moves;
+  int not_canonical;
+  long long sat_samples;
+  int sat_singletons;
+  int ret_cutoff;
+  int ret_evicted;
+  long long ret_hits;
+  int ret_purged_at;
+  // saddles:
+  int flood_next;       // next minimum to flood (-1 = flooding done)
+  int flooded;
+};
+
+// structure as pair table with energy and a number (hits), shared with shard files (shard.h)
+void write_struct(FILE *f, const struct_en &he, int hits);
+bool read_struct(FILE *f, int len, struct_en &he, int &hits);
+
+// write sampling phase, returns false on error
+bool checkpoint_save_sampling(const char *filename, const char *seq, CheckpointInfo &info, std::unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> &structs, std::map<struct_en, int, comps_entries> &output);
+
+// write saddle phase (energy_barr and findpath_barr can be NULL if nothing is computed yet), returns false on error
+bool checkpoint_save_saddles(const char *filename, const char *seq, CheckpointInfo &info, std::vector<struct_en> &minima, std::vector<int> &counts, float *energy_barr, bool *findpath_barr);
+
+// only the sequence of a checkpoint (to be freed) or NULL on error
+char *checkpoint_seq(const char *filename);
+
+// read checkpoint, returns sequence (to be freed) or NULL on error
+//  sampling phase fills structs and output, saddle phase fills minima, counts, energy_barr and findpath_barr (NULL if not computed yet)
+char *checkpoint_load(const char *filename, CheckpointInfo &info, std::unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> &structs, std::map<struct_en, int, comps_entries> &output,
+                      std::vector<struct_en> &minima, std::vector<int> &counts, float *&energy_barr, bool *&findpath_barr);
+
+#endif
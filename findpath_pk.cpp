@@ -12,6 +12,7 @@
 
 #include "findpath_pk.h"
 #include "move_set_pk.h"
+#include "profile.h"
 
 extern "C" {
   #include "pair_mat.h"
@@ -375,6 +376,7 @@ int Findpath::ComputeSaddle(short *str1, short *str2)
 
       if (inter.dist ==i) pqueue.pop();
       else break;
+      PROF_COUNT(PROF_FINDPATH);
 
       // if we are going to proceed the structure with lower energy than optimal:
       int stored_en = structs_visited[inter.structure];
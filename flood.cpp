@@ -11,6 +11,8 @@ extern "C" {
 
 #include "flood.h"
 #include "RNAlocmin.h"
+#include "profile.h"
+#include "run_stats.h"
 
 using namespace std;
 
@@ -153,17 +155,13 @@ int flood_func2(Structure *input, Structure *output)
   }
 }
 
-struct_en* flood(const struct_en &he, SeqInfo &sqi, int &saddle_en, int maxh, bool pknots, bool flood_total)
+struct_en* flood(const struct_en &he, SeqInfo &sqi, const WalkOpts &wo, int &saddle_en, int flood_max, int maxh, bool flood_total, RunStats *stats)
 {
   int count = 0;
-  debugg = Opt.verbose_lvl>2;
+  debugg = wo.verbose>2;
 
   struct_en *res = NULL;
 
-  // save deg.first + create deg
-  bool first = Opt.first;
-  Opt.first = true;
-
   // if minh specified, assign top_lvl and flood_total
   if (maxh>0) {
     top_lvl = he.energy + maxh;
@@ -174,7 +172,7 @@ struct_en* flood(const struct_en &he, SeqInfo &sqi, int &saddle_en, int maxh, bo
   }
 
   ///#### PKNOTS
-  if (pknots) {
+  if (wo.pknots) {
     // init priority queue
     while (!neighs2.empty()) {
       //fprintf(stderr, "-neighs size: %d\n", (int)neighs.size());
@@ -193,21 +191,22 @@ struct_en* flood(const struct_en &he, SeqInfo &sqi, int &saddle_en, int maxh, bo
     }
 
     // FLOOOD!
-    while ((int)hash_flood2.size() < Opt.floodMax) {
+    while ((int)hash_flood2.size() < flood_max) {
       // should not be empty (only when maxh specified)
       if (neighs2.empty()) break;
 
       // get structure
       Structure *he_top = neighs2.top();
       neighs2.pop();
+      PROF_COUNT(PROF_FLOOD);
       energy_lvl = he_top->energy;
 
-      if (Opt.verbose_lvl>2) fprintf(stderr, "  neighbours of: %s %.2f (%d)\n", pt_to_str(he_top->str).c_str(), he_top->energy/100.0, (int)neighs2.size());
+      if (wo.verbose>2) fprintf(stderr, "  neighbours of: %s %.2f (%d)\n", pt_to_str(he_top->str).c_str(), he_top->energy/100.0, (int)neighs2.size());
 
-      int verbose = Opt.verbose_lvl<2?0:Opt.verbose_lvl-2;
-      he_top->energy = browse_neighs_pk_pt(sqi.seq, he_top, sqi.s0, sqi.s1, Opt.shift, verbose, flood_func2);
+      int verbose = wo.verbose<2?0:wo.verbose-2;
+      he_top->energy = browse_neighs_pk_pt(sqi.seq, he_top, sqi.s0, sqi.s1, sqi.pairs, wo.shift, verbose, flood_func2);
 
-      if (found_exit && Opt.verbose_lvl>2) fprintf(stderr, "sad= %6.2f    : %s %.2f\n", saddle_en/100.0, pt_to_str(he_top->str).c_str(), he_top->energy/100.0);
+      if (found_exit && wo.verbose>2) fprintf(stderr, "sad= %6.2f    : %s %.2f\n", saddle_en/100.0, pt_to_str(he_top->str).c_str(), he_top->energy/100.0);
 
       // did we find exit from basin?
       if (found_exit) {
@@ -253,21 +252,22 @@ struct_en* flood(const struct_en &he, SeqInfo &sqi, int &saddle_en, int maxh, bo
     }
 
     // FLOOOD!
-    while ((int)hash_flood.size() < Opt.floodMax) {
+    while ((int)hash_flood.size() < flood_max) {
       // should not be empty (only when maxh specified)
       if (neighs.empty()) break;
 
       // get structure
       struct_en *he_top = neighs.top();
       neighs.pop();
+      PROF_COUNT(PROF_FLOOD);
       energy_lvl = he_top->energy;
 
-      if (Opt.verbose_lvl>2) fprintf(stderr, "  neighbours of: %s %.2f\n", pt_to_str(he_top->structure).c_str(), he_top->energy/100.0);
+      if (wo.verbose>2) fprintf(stderr, "  neighbours of: %s %.2f\n", pt_to_str(he_top->structure).c_str(), he_top->energy/100.0);
 
-      int verbose = Opt.verbose_lvl<2?0:Opt.verbose_lvl-2;
-      he_top->energy = browse_neighs_pt(sqi.seq, he_top->structure, sqi.s0, sqi.s1, verbose, Opt.shift, Opt.noLP, flood_func);
+      int verbose = wo.verbose<2?0:wo.verbose-2;
+      he_top->energy = browse_neighs_en(sqi.seq, he_top->structure, sqi.s0, sqi.s1, sqi.pairs, verbose, wo.shift, wo.noLP, flood_func);
 
-      if (found_exit && Opt.verbose_lvl>2) fprintf(stderr, "sad= %6.2f    : %s %.2f\n", saddle_en/100.0, pt_to_str(he_top->structure).c_str(), he_top->energy/100.0);
+      if (found_exit && wo.verbose>2) fprintf(stderr, "sad= %6.2f    : %s %.2f\n", saddle_en/100.0, pt_to_str(he_top->structure).c_str(), he_top->energy/100.0);
 
       // did we find exit from basin?
       if (found_exit) {
@@ -293,8 +293,7 @@ struct_en* flood(const struct_en &he, SeqInfo &sqi, int &saddle_en, int maxh, bo
     free_hash(hash_flood);
   }  /// #### END OF PKNOTS BRANCH
 
-  // restore deg options
-  Opt.first = first;
+  if (stats) stats->Flood(count, res!=NULL);
 
   // return found? structure
   return res;
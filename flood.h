@@ -12,10 +12,15 @@ extern "C" {
 bool compare_vect (const struct_en &lhs, const struct_en &rhs);
 bool compare_vect (const Structure &lhs, const Structure &rhs);
 
+class RunStats;
+
 // flood the structure - return one below saddle structure (should be freed then) energy of saddle is in "saddle_en"
+  // wo = move set (pknots, shift, noLP) and verbosity
   // minh_total - if set to true then flood also down and try to find energetically lower LM
   // maxh = height of flood (0 = infinity)
+  // flood_max = maximal number of structures in flood (--floodMax)
+  // stats = where to count the flood (NULL = nowhere)
   // if returns NULL - in saddle_en is fail status - 1 for maxh reached, 0 otherwise
-struct_en* flood(const struct_en &str, SeqInfo &sqi, int &saddle_en, int maxh = 0, bool pknots = false, bool minh_total = false);
+struct_en* flood(const struct_en &str, SeqInfo &sqi, const WalkOpts &wo, int &saddle_en, int flood_max, int maxh = 0, bool minh_total = false, RunStats *stats = NULL);
 
 #endif
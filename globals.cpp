@@ -22,6 +22,7 @@ SeqInfo::SeqInfo()
 {
   seq = NULL;
   s0 = s1 = NULL;
+  pairs = NULL;
 
   update_fold_params();
 }
@@ -31,6 +32,7 @@ SeqInfo::~SeqInfo()
   if (s0) free(s0);
   if (s1) free(s1);
   if (seq) free(seq);
+  pair_info_free(pairs);
 }
 
 void SeqInfo::Init(char *seq) {
@@ -40,10 +42,35 @@ void SeqInfo::Init(char *seq) {
   update_fold_params();
   s0 = encode_sequence(seq, 0);
   s1 = encode_sequence(seq, 1);
+  pair_info_free(pairs);
+  pairs = pair_info_new(seq);
+}
+
+WalkOpts::WalkOpts()
+{
+  pknots = false;
+  noLP = false;
+  shift = false;
+  first = false;
+  rand = false;
+  neighs = false;
+  verbose = 0;
 }
 
 Options::Options()
 {
+  // defaults as in RNAlocmin.ggo (for use without command line)
+  minh = 0;
+  noLP = false;
+  EOM = true;
+  first = false;
+  rand = false;
+  shift = false;
+  verbose_lvl = 0;
+  floodMax = 1000;
+  neighs = false;
+  trust_en = false;
+  pknots = false;
 }
 
 int Options::Init(gengetopt_args_info &args_info)
@@ -106,6 +133,67 @@ int Options::Init(gengetopt_args_info &args_info)
     ret = -1;
   }
 
+  if (args_info.two_phase_flag && (args_info.find_num_given || args_info.just_output_flag)) {
+    fprintf(stderr, "Two-phase processing (--two-phase) cannot be combined with --find-num and --just-output\n");
+    ret = -1;
+  }
+
+  if (args_info.saturation_given && (args_info.saturation_arg<=0.0 || args_info.saturation_arg>=1.0)) {
+    fprintf(stderr, "Saturation threshold should be in range (0.0-1.0)\n");
+    ret = -1;
+  }
+
+  if (args_info.saturation_given && (args_info.two_phase_flag || args_info.just_output_flag)) {
+    fprintf(stderr, "Saturation stopping (--saturation) cannot be combined with --two-phase and --just-output\n");
+    ret = -1;
+  }
+
+  if (args_info.batch_given && (args_info.previous_given || args_info.fix_barriers_given)) {
+    fprintf(stderr, "Batch mode (--batch) cannot be combined with --previous and --fix-barriers\n");
+    ret = -1;
+  }
+
+  if (args_info.batch_jobs_arg<1) {
+    fprintf(stderr, "Number of batch jobs should be positive integer\n");
+    ret = -1;
+  }
+
+  if ((args_info.server_flag || args_info.server_socket_given) && (args_info.batch_given || args_info.previous_given || args_info.fix_barriers_given)) {
+    fprintf(stderr, "Server mode (--server) cannot be combined with --batch, --previous and --fix-barriers\n");
+    ret = -1;
+  }
+
+  if (args_info.checkpoint_given && (args_info.two_phase_flag || args_info.just_output_flag || args_info.batch_given || args_info.server_flag || args_info.server_socket_given || args_info.allegiance_given || args_info.fix_barriers_given)) {
+    fprintf(stderr, "Checkpoints (--checkpoint) cannot be combined with --two-phase, --just-output, --batch, --server, --allegiance and --fix-barriers\n");
+    ret = -1;
+  }
+
+  if (args_info.resume_flag && !args_info.checkpoint_given) {
+    fprintf(stderr, "Resume (--resume) needs the --checkpoint file\n");
+    ret = -1;
+  }
+
+  if (args_info.checkpoint_interval_arg<0) {
+    fprintf(stderr, "Interval between checkpoints should be non-negative integer\n");
+    ret = -1;
+  }
+
+  if (args_info.merge_given && (args_info.previous_given || args_info.fix_barriers_given || args_info.batch_given || args_info.server_flag || args_info.server_socket_given || args_info.checkpoint_given ||
+      args_info.two_phase_flag || args_info.just_output_flag || args_info.saturation_given || args_info.bounded_flag || args_info.allegiance_given)) {
+    fprintf(stderr, "Merging of shards (--merge) cannot be combined with --previous, --fix-barriers, --batch, --server, --checkpoint, --two-phase, --just-output, --saturation, --bounded and --allegiance\n");
+    ret = -1;
+  }
+
+  if (args_info.shard_out_given && (args_info.just_output_flag || args_info.fix_barriers_given || args_info.server_flag || args_info.server_socket_given)) {
+    fprintf(stderr, "Summary for merging (--shard-out) cannot be combined with --just-output, --fix-barriers and --server\n");
+    ret = -1;
+  }
+
+  if (args_info.bounded_flag && (args_info.find_num_given || args_info.allegiance_given)) {
+    fprintf(stderr, "Bounded retention of minima (--bounded) cannot be combined with --find-num and --allegiance\n");
+    ret = -1;
+  }
+
   if (ret ==-1) return -1;
 
   // adjust options
@@ -119,10 +207,24 @@ int Options::Init(gengetopt_args_info &args_info)
   floodMax = args_info.floodMax_arg;
   pknots = args_info.pseudoknots_flag;
   neighs = args_info.neighborhood_flag;
+  trust_en = args_info.trust_energy_flag;
 
   return ret;
 }
 
+WalkOpts Options::Walk()
+{
+  WalkOpts wo;
+  wo.pknots = pknots;
+  wo.noLP = noLP;
+  wo.shift = shift;
+  wo.first = first;
+  wo.rand = rand;
+  wo.neighs = neighs;
+  wo.verbose = verbose_lvl;
+  return wo;
+}
+
 /*Degen::Degen()
 {
   current = 0;
@@ -9,6 +9,7 @@ extern "C" {
 }
 #include "hash_util.h"
 #include "move_set_pk.h"
+#include "pair_info.h"
 
 // some global counters
 static int num_moves = 0;
@@ -21,12 +22,28 @@ public:
   char *seq;
   short *s0;
   short *s1;
+  pair_info *pairs;  // pairability bitsets of seq (passed to all walks on seq)
 
   SeqInfo();
   ~SeqInfo();
   void Init(char *seq);
 };
 
+// walk method and move set of gradient walks and flooding (Options::Walk() gives the ones from the command line)
+class WalkOpts {
+public:
+  bool pknots;  // pseudoknots (gfold model)
+  bool noLP;    // only canonical structures
+  bool shift;   // shift moves
+  bool first;   // first found lower neighbor, not the lowest one
+  bool rand;    // random lower neighbor
+  bool neighs;  // Neighborhood routines
+  int verbose;  // level of verbosity
+
+  // gradient descent with insertions and deletions
+  WalkOpts();
+};
+
 // cute options singleton class
 class Options {
   // options
@@ -40,6 +57,7 @@ public:
   int verbose_lvl; // level of verbosity
   int floodMax; // cap for flooding
   bool neighs;  // use neighborhood routines?
+  bool trust_en; // take energies of input structures from input?
 
   bool pknots; // flag for pseudoknots.
 
@@ -48,6 +66,9 @@ public:
 
   // return 0 if success
   int Init(gengetopt_args_info &args_info);
+
+  // walk and move set options (for LMContext)
+  WalkOpts Walk();
 };
 /*
 // structure for degeneracy
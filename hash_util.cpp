@@ -68,19 +68,42 @@ void print_stats(unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> &struc
   fprintf(stderr, "Mean  : %.3f (Entrpy: %.3f)\n", mean, entropy);
 }
 
-void add_stats(unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> &structs, map<struct_en, int, comps_entries> &output)
+long long add_stats(unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> &structs, map<struct_en, int, comps_entries> &output, int cutoff)
 {
+  long long rest = 0;
   unordered_map<struct_en, gw_struct, hash_fncts>::iterator it;
   for (it=structs.begin(); it!=structs.end(); it++) {
     // add stats:
     //fprintf(stderr, "struct: %s %6.2f %d\n", pt_to_str(it->second.he.structure).c_str(), it->second.he.energy/100.0, it->second.count);
 
+    // minimum is not in output anymore
+    if (it->second.he.energy > cutoff) {
+      rest += it->second.count-1;
+      continue;
+    }
+
     if (output.count(it->second.he) == 0) {
       fprintf(stderr, "ERROR: output does not contain structure it should!!!\n");
       //if (!Opt.pknots) exit(EXIT_FAILURE);
     }
     output[it->second.he] += it->second.count-1;
   }
+  return rest;
+}
+
+// purge hash
+long long purge_hash(unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> &structs, int cutoff)
+{
+  long long rest = 0;
+  unordered_map<struct_en, gw_struct, hash_fncts>::iterator it;
+  for (it=structs.begin(); it!=structs.end(); ) {
+    if (it->second.he.energy > cutoff) {
+      rest += it->second.count-1;
+      free(it->first.structure);
+      it = structs.erase(it);
+    } else it++;
+  }
+  return rest;
 }
 
 // free hash
@@ -298,7 +298,10 @@ struct comps_entries_rev {
 // print stats about hash
 void print_stats(std::unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> &structs);
 // add stats from hash to output map
-void add_stats(std::unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> &structs, std::map<struct_en, int, comps_entries> &output);
+//  (hits of minima above cutoff are not added, their number is returned)
+long long add_stats(std::unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> &structs, std::map<struct_en, int, comps_entries> &output, int cutoff = INT_MAX);
+// remove entries whose minima are above cutoff, returns number of their repeated hits
+long long purge_hash(std::unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> &structs, int cutoff);
 
 
 // free hash
@@ -0,0 +1,409 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "kinetics.h"
+#include "RNAlocmin.h"
+
+using namespace std;
+
+// build sparse (symmetrized) generator from saddle heights
+void RateCSR::Build(int num, float *energy_barr, vector<int> &output_en, double _kT)
+{
+  this->num = num;
+  row_ptr.assign(num+1, 0);
+
+  // saddles are symmetric, so the pattern of row j = pattern of column j
+  for (int j=0; j<num; j++) {
+    int64_t cnt = 1; // diagonal
+    float *barr = energy_barr+(size_t)j*num;
+    for (int i=0; i<num; i++) {
+      if (i!=j && barr[i]<RATES_NO_SADDLE) cnt++;
+    }
+    row_ptr[j+1] = row_ptr[j]+cnt;
+  }
+  col.resize(row_ptr[num]);
+  val.resize(row_ptr[num]);
+
+  norm_inf = 0.0;
+  #pragma omp parallel for schedule(static) reduction(max:norm_inf)
+  for (int j=0; j<num; j++) {
+    int64_t pos = row_ptr[j];
+    int64_t diag = 0;
+    double en_j = output_en[j]/100.0;
+    double outflow = 0.0;
+    double row_sum = 0.0;
+    for (int i=0; i<num; i++) {
+      if (i==j) {
+        diag = pos;
+        col[pos++] = j;
+        continue;
+      }
+      float barr = energy_barr[(size_t)j*num+i];
+      if (barr>=RATES_NO_SADDLE) continue;
+      // rate(i->j)*sqrt(eq_i/eq_j) = exp(-(barr - (E_i+E_j)/2)/kT) - symmetric
+      double sym = exp(-(barr - (output_en[i]+output_en[j])/200.0)/_kT);
+      col[pos] = i;
+      val[pos++] = sym;
+      row_sum += sym;
+      outflow += exp(-(barr - en_j)/_kT);  // j -> i
+    }
+    val[diag] = -outflow;
+    row_sum += outflow;
+    if (row_sum > norm_inf) norm_inf = row_sum;
+  }
+
+  // connected components (rates obey detailed balance, so equilibrium of each is Boltzmann)
+  comp.assign(num, -1);
+  eq.assign(num, 0.0);
+  num_comp = 0;
+  vector<int> stack;
+  for (int i=0; i<num; i++) {
+    if (comp[i]!=-1) continue;
+    vector<int> members;
+    comp[i] = num_comp;
+    stack.push_back(i);
+    while (!stack.empty()) {
+      int j = stack.back();
+      stack.pop_back();
+      members.push_back(j);
+      for (int64_t k=row_ptr[j]; k<row_ptr[j+1]; k++) {
+        if (comp[col[k]]==-1) {
+          comp[col[k]] = num_comp;
+          stack.push_back(col[k]);
+        }
+      }
+    }
+    // boltzmann weights relative to lowest member
+    int en_min = output_en[members[0]];
+    for (unsigned int k=0; k<members.size(); k++) en_min = min(en_min, output_en[members[k]]);
+    double Z = 0.0;
+    for (unsigned int k=0; k<members.size(); k++) {
+      eq[members[k]] = exp(-(output_en[members[k]]-en_min)/100.0/_kT);
+      Z += eq[members[k]];
+    }
+    for (unsigned int k=0; k<members.size(); k++) eq[members[k]] /= Z;
+    num_comp++;
+  }
+}
+
+void RateCSR::Multiply(const double *vec, double *res) const
+{
+  #pragma omp parallel for schedule(static) if (num>1024)
+  for (int j=0; j<num; j++) {
+    double sum = 0.0;
+    for (int64_t k=row_ptr[j]; k<row_ptr[j+1]; k++) {
+      sum += val[k]*vec[col[k]];
+    }
+    res[j] = sum;
+  }
+}
+
+// vector helpers (parallel for big vectors)
+static double dot(const double *a, const double *b, int n)
+{
+  double sum = 0.0;
+  #pragma omp parallel for schedule(static) reduction(+:sum) if (n>4096)
+  for (int i=0; i<n; i++) sum += a[i]*b[i];
+  return sum;
+}
+
+static void axpy(double alpha, const double *x, double *y, int n)
+{
+  #pragma omp parallel for schedule(static) if (n>4096)
+  for (int i=0; i<n; i++) y[i] += alpha*x[i];
+}
+
+static double norm2(const double *a, int n)
+{
+  return sqrt(dot(a, a, n));
+}
+
+// round to 2 significant digits upwards (as in expokit)
+static double round_step(double t)
+{
+  if (!(t>0.0) || isinf(t)) return t;
+  double s = pow(10.0, floor(log10(t))-1);
+  return ceil(t/s)*s;
+}
+
+// solve A*X = B for small dense matrices (n x n, row-major), result in B
+static void solve_dense(vector<double> &A, vector<double> &B, int n)
+{
+  for (int k=0; k<n; k++) {
+    // pivot
+    int piv = k;
+    for (int i=k+1; i<n; i++) if (fabs(A[i*n+k]) > fabs(A[piv*n+k])) piv = i;
+    if (piv != k) {
+      for (int j=0; j<n; j++) {
+        swap(A[k*n+j], A[piv*n+j]);
+        swap(B[k*n+j], B[piv*n+j]);
+      }
+    }
+    double d = A[k*n+k];
+    for (int i=k+1; i<n; i++) {
+      double f = A[i*n+k]/d;
+      if (f==0.0) continue;
+      for (int j=k; j<n; j++) A[i*n+j] -= f*A[k*n+j];
+      for (int j=0; j<n; j++) B[i*n+j] -= f*B[k*n+j];
+    }
+  }
+  for (int k=n-1; k>=0; k--) {
+    for (int j=0; j<n; j++) {
+      double sum = B[k*n+j];
+      for (int i=k+1; i<n; i++) sum -= A[k*n+i]*B[i*n+j];
+      B[k*n+j] = sum/A[k*n+k];
+    }
+  }
+}
+
+static void mult_dense(const vector<double> &A, const vector<double> &B, vector<double> &C, int n)
+{
+  C.assign(n*n, 0.0);
+  for (int i=0; i<n; i++) {
+    for (int k=0; k<n; k++) {
+      double a = A[i*n+k];
+      if (a==0.0) continue;
+      for (int j=0; j<n; j++) C[i*n+j] += a*B[k*n+j];
+    }
+  }
+}
+
+// F = exp(t*H) for small dense H (n x n, row-major, leading dimension ld), Pade(6) with scaling and squaring
+static void expm_small(const vector<double> &H, int ld, int n, double t, vector<double> &F)
+{
+  const int q = 6;
+  vector<double> A(n*n);
+  double norm = 0.0;
+  for (int i=0; i<n; i++) {
+    double sum = 0.0;
+    for (int j=0; j<n; j++) {
+      A[i*n+j] = t*H[i*ld+j];
+      sum += fabs(A[i*n+j]);
+    }
+    norm = max(norm, sum);
+  }
+  int s = (norm>0.5 ? (int)(log(norm)/log(2.0))+2 : 0);
+  double scale = ldexp(1.0, -s);
+  for (int i=0; i<n*n; i++) A[i] *= scale;
+
+  // numerator and denominator
+  vector<double> N(n*n, 0.0), D(n*n, 0.0), X(n*n, 0.0), tmp;
+  for (int i=0; i<n; i++) N[i*n+i] = D[i*n+i] = X[i*n+i] = 1.0;
+  double c = 1.0;
+  for (int k=1; k<=q; k++) {
+    c = c*(q-k+1)/(double)(k*(2*q-k+1));
+    mult_dense(X, A, tmp, n);
+    X.swap(tmp);
+    double sgn = (k%2 ? -1.0 : 1.0);
+    for (int i=0; i<n*n; i++) {
+      N[i] += c*X[i];
+      D[i] += sgn*c*X[i];
+    }
+  }
+  solve_dense(D, N, n);
+
+  // squaring
+  for (int k=0; k<s; k++) {
+    mult_dense(N, N, tmp, n);
+    N.swap(tmp);
+  }
+  F.swap(N);
+}
+
+// w = exp(t*A) w, Krylov subspace projection with adaptive time stepping (expokit's expv)
+//   t_new - suggested inner time step (kept between calls)
+//   w should have no component in the stationary distribution - close to equilibrium
+//   the Arnoldi vectors of A*w would be only roundoff and the step control fails
+static int expv(const RateCSR &A, double t, vector<double> &w, double &t_new)
+{
+  const int n = A.num;
+  const int m = min(n, 30);
+  const double tol = 1e-7, btol = 1e-7, gamma = 0.9, delta = 1.2;
+  const int mxrej = 10;
+
+  double anorm = max(A.norm_inf, 1e-300);
+  double beta = norm2(&w[0], n);
+  if (beta < 1e-15 || t<=0.0) return 0;
+
+  if (t_new<=0.0) {
+    double fact = pow((m+1)/exp(1.0), m+1)*sqrt(2.0*M_PI*(m+1));
+    t_new = round_step((1.0/anorm)*pow((fact*tol)/(4.0*beta*anorm), 1.0/m));
+  }
+
+  vector<double> V((m+1)*n);
+  vector<double> H((m+2)*(m+2));
+  vector<double> F;
+  vector<double> p(n);
+
+  double t_now = 0.0;
+  int steps = 0;
+  while (t_now < t) {
+    steps++;
+    double t_step = min(t-t_now, t_new);
+    int k1 = 2, mb = m;
+    fill(H.begin(), H.end(), 0.0);
+
+    // Arnoldi
+    double *v0 = &V[0];
+    for (int i=0; i<n; i++) v0[i] = w[i]/beta;
+    for (int j=0; j<m; j++) {
+      A.Multiply(&V[j*n], &p[0]);
+      for (int i=0; i<=j; i++) {
+        double h = dot(&V[i*n], &p[0], n);
+        H[i*(m+2)+j] = h;
+        axpy(-h, &V[i*n], &p[0], n);
+      }
+      double s = norm2(&p[0], n);
+      if (beta*s*(t-t_now) < btol) { // happy breakdown - residual has no effect on the rest of the interval
+        k1 = 0;
+        mb = j+1;
+        t_step = t-t_now;
+        break;
+      }
+      H[(j+1)*(m+2)+j] = s;
+      double *vj = &V[(j+1)*n];
+      for (int i=0; i<n; i++) vj[i] = p[i]/s;
+    }
+    double avnorm = 0.0;
+    if (k1 != 0) {
+      H[(m+1)*(m+2)+m] = 1.0;
+      A.Multiply(&V[m*n], &p[0]);
+      avnorm = norm2(&p[0], n);
+    }
+
+    // error estimate and step size control
+    double err_loc = btol, xm = 1.0/m;
+    int mx;
+    for (int ireject=0; ; ireject++) {
+      mx = mb + k1;
+      expm_small(H, m+2, mx, t_step, F);
+      if (k1 == 0) {
+        err_loc = btol;
+        break;
+      }
+      double phi1 = fabs(beta*F[m*mx]);
+      double phi2 = fabs(beta*F[(m+1)*mx]*avnorm);
+      if (phi1 > 10.0*phi2) {
+        err_loc = phi2;
+        xm = 1.0/m;
+      } else if (phi1 > phi2) {
+        err_loc = (phi1*phi2)/(phi1-phi2);
+        xm = 1.0/m;
+      } else {
+        err_loc = phi1;
+        xm = 1.0/max(m-1, 1);
+      }
+      if (err_loc <= delta*t_step*tol) break;
+      if (ireject == mxrej) {
+        fprintf(stderr, "WARNING: kinetics: requested tolerance too high (step %g)\n", t_step);
+        break;
+      }
+      // the exponent is small (1/m), so shrink at least by half to keep the rejections few
+      t_step = round_step(t_step*min(0.5, gamma*pow(t_step*tol/err_loc, xm)));
+    }
+
+    // w = beta * V * F[:,0]
+    int mv = mb + max(0, k1-1);
+    fill(w.begin(), w.end(), 0.0);
+    for (int k=0; k<mv && k<=m; k++) axpy(beta*F[k*mx], &V[k*n], &w[0], n);
+    beta = norm2(&w[0], n);
+    // populations are O(1), so the rest is already in equilibrium
+    if (beta < 1e-15) break;
+
+    t_now += t_step;
+    if (k1 != 0) t_new = round_step(t_step*min(10.0, gamma*pow(t_step*tol/max(err_loc, 1e-300), xm)));
+  }
+  return steps;
+}
+
+int kinetics(char *filename, RateCSR &rates, vector<double> &p0, double t0, double t8, double tinc, int verbose_lvl)
+{
+  FILE *out = fopen(filename, "w");
+  if (out==NULL) {
+    fprintf(stderr, "ERROR: couldn't open file \"%s\" for kinetics!\n", filename);
+    return -1;
+  }
+  if (t0<=0.0 || tinc<=1.0 || t8<t0) {
+    fprintf(stderr, "ERROR: kinetics: wrong time grid (t0=%g, t8=%g, tinc=%g)\n", t0, t8, tinc);
+    fclose(out);
+    return -1;
+  }
+  setvbuf(out, NULL, _IOFBF, 1<<20);
+
+  int num = rates.num;
+
+  // split p0 into equilibrium part (does not change) and the rest, which decays to zero
+  //   the rest is evolved in symmetrized coordinates u = D^(-1/2) (p - eq)
+  vector<double> mass(rates.num_comp, 0.0);
+  for (int i=0; i<num; i++) mass[rates.comp[i]] += p0[i];
+  vector<double> stat(num), sq(num), u(num), p(num);
+  for (int i=0; i<num; i++) {
+    stat[i] = mass[rates.comp[i]]*rates.eq[i];
+    sq[i] = sqrt(rates.eq[i]);
+    u[i] = (sq[i]>0.0 ? (p0[i] - stat[i])/sq[i] : 0.0);
+  }
+
+  fprintf(out, "# kinetics of %d minima, t0=%g, t8=%g, tinc=%g\n", num, t0, t8, tinc);
+  fprintf(out, "# time p1 ... p%d\n", num);
+
+  double t_now = 0.0, t_next = t0, t_hint = 0.0;
+  int points = 0, steps = 0;
+  while (t_next <= t8*(1.0+1e-12)) {
+    steps += expv(rates, t_next - t_now, u, t_hint);
+    t_now = t_next;
+
+    // populations must be non-negative and sum to 1
+    double sum = 0.0;
+    for (int i=0; i<num; i++) {
+      p[i] = max(stat[i] + sq[i]*u[i], 0.0);
+      sum += p[i];
+    }
+    if (sum > 0.0) for (int i=0; i<num; i++) p[i] /= sum;
+
+    fprintf(out, "%22.20e ", t_now);
+    for (int i=0; i<num; i++) fprintf(out, "%e ", p[i]);
+    fprintf(out, "\n");
+    points++;
+
+    t_next = t_now*tinc;
+  }
+  fclose(out);
+
+  if (verbose_lvl>0) fprintf(stderr, "Kinetics: %d time points, %d Krylov steps, %d nonzeros.\n", points, steps, (int)rates.val.size());
+  return points;
+}
+
+bool kinetics_p0(int num, int count, char **p0_args, vector<double> &p0)
+{
+  if (num==0) {
+    fprintf(stderr, "ERROR: no minima for kinetics\n");
+    return false;
+  }
+  p0.assign(num, 0.0);
+  if (count==0) {
+    p0[num-1] = 1.0;
+    return true;
+  }
+  double sum = 0.0;
+  for (int k=0; k<count; k++) {
+    int i;
+    double x;
+    if (sscanf(p0_args[k], "%d=%lf", &i, &x)!=2 || i<1 || i>num || x<0.0) {
+      fprintf(stderr, "ERROR: wrong start population \"%s\" (format \"i=x\", 1<=i<=%d)\n", p0_args[k], num);
+      return false;
+    }
+    p0[i-1] += x;
+    sum += x;
+  }
+  if (sum<=0.0) {
+    fprintf(stderr, "ERROR: start population sums to zero\n");
+    return false;
+  }
+  for (int i=0; i<num; i++) p0[i] /= sum;
+  return true;
+}
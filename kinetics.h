@@ -0,0 +1,39 @@
+#ifndef __KINETICS_H
+#define __KINETICS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+// sparse rate matrix (CSR) of the master equation dp/dt = Q^T p, rates obey detailed balance,
+//  so it is stored symmetrized as A = D^(-1/2) Q^T D^(1/2) (D = diag(equilibrium distribution)):
+//  row j contains rate(i->j)*sqrt(eq_i/eq_j) (columns i) and the diagonal -sum_k rate(j->k)
+struct RateCSR {
+  int num;
+  std::vector<int64_t> row_ptr;  // as in print_rates_bin (nnz may not fit in int)
+  std::vector<int> col;
+  std::vector<double> val;
+  double norm_inf;  // infinity norm of A
+
+  // connected components of the rate graph and equilibrium distribution in each of them
+  int num_comp;
+  std::vector<int> comp;
+  std::vector<double> eq;
+
+  // build from saddle heights (only computed saddles are used) and minima energies
+  void Build(int num, float *energy_barr, std::vector<int> &output_en, double _kT);
+
+  // res = A*vec (parallel)
+  void Multiply(const double *vec, double *res) const;
+};
+
+// integrate master equation on rates with start population p0 for time grid t0, t0*tinc, ..., t8
+//   writes populations (1 line per time point: time p1 p2 ... pnum) to file
+//   returns number of time points written or -1 on error
+int kinetics(char *filename, RateCSR &rates, std::vector<double> &p0, double t0, double t8, double tinc, int verbose_lvl = 0);
+
+// parse start populations in format "i=x" (i is 1-based number of LM), normalize to 1
+//   if none given, all population is in the highest LM, returns false on error (also if there are no minima)
+bool kinetics_p0(int num, int count, char **p0_args, std::vector<double> &p0);
+
+#endif
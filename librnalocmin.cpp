@@ -0,0 +1,569 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <limits.h>
+#include <string.h>
+
+#include <string>
+#include <set>
+#include <vector>
+#include <algorithm>
+
+extern "C" {
+  #include "fold.h"
+  #include "findpath.h"
+}
+
+#include "librnalocmin.h"
+#include "findpath_pk.h"
+#include "RNAlocmin.h"
+#include "flood.h"
+#include "profile.h"
+#include "barrier_tree.h"
+#include "run_stats.h"
+
+using namespace std;
+
+LMContext::LMContext(const char *seq, const WalkOpts &walk):walk(walk)
+{
+  sqi.Init((char*)seq);
+  stats = NULL;
+}
+
+int lm_energy(LMContext &ctx, short *pt)
+{
+  SeqInfo &sqi = ctx.sqi;
+  return ctx.walk.pknots? energy_of_struct_pk(sqi.seq, pt, sqi.s0, sqi.s1):energy_of_structure_pt(sqi.seq, pt, sqi.s0, sqi.s1, 0);
+}
+
+int lm_descend(LMContext &ctx, struct_en &str, int *length)
+{
+  int steps;
+  move_set(str, ctx.sqi, ctx.walk, &steps);
+  // histogram of gradient walks only
+  if (ctx.stats && !ctx.walk.rand && steps>=0) ctx.stats->Walk(steps);
+  if (length) *length = steps;
+  return str.energy;
+}
+
+// comparator for indices into vector of structures
+struct comps_index {
+  const vector<struct_en> &strs;
+  comps_index(const vector<struct_en> &strs):strs(strs) {}
+  bool operator() (int a, int b) const {
+    return compf_short(strs[a].structure, strs[b].structure);
+  }
+};
+
+void lm_descend_all(LMContext &ctx, vector<struct_en> &strs, vector<struct_en> &lms)
+{
+  SeqInfo &sqi = ctx.sqi;
+  int num = strs.size();
+
+  // lexicographic order, so that consecutive walks share most of the structure
+  vector<int> order(num);
+  for (int i=0; i<num; i++) order[i] = i;
+  sort(order.begin(), order.end(), comps_index(strs));
+
+  struct_en empty;
+  empty.structure = NULL;
+  empty.energy = 0;
+  lms.assign(num, empty);
+
+  // energy parameters of pknots are set up lazily - do it before the threads start
+  if (ctx.walk.pknots && num>0) energy_of_struct_pk(sqi.seq, strs[order[0]].structure, sqi.s0, sqi.s1);
+
+  // Neighborhood keeps its state in statics
+  #pragma omp parallel for schedule(dynamic, 16) if (!ctx.walk.neighs)
+  for (int k=0; k<num; k++) {
+    int i = order[k];
+    if (strs[i].energy == INT_MAX) strs[i].energy = lm_energy(ctx, strs[i].structure);
+
+    //is it canonical (noLP)
+    if (ctx.walk.noLP && find_lone_pair(strs[i].structure)!=-1) continue;
+
+    //debugging
+    if (ctx.walk.verbose>1) fprintf(stderr, "processing: %d %s\n", i, pt_to_str_pk(strs[i].structure).c_str());
+
+    // descend
+    struct_en lm = strs[i];
+    lm.structure = allocopy(strs[i].structure);
+    lm_descend(ctx, lm);
+    // only some types of PK allowed!!!
+    if (ctx.walk.pknots && lm.energy == INT_MAX) {
+      free(lm.structure);
+      continue;
+    }
+    lms[i] = lm;
+  }
+}
+
+LMSampler::LMSampler(int hash_size):structs(hash_size)
+{
+  Retention ret = {false, 0, INT_MAX, INT_MAX, 0, 0, 1<<16};
+  retention = ret;
+  Saturation sat = {false, 0.0, 0, 0, 0};
+  saturation = sat;
+  walked = NULL;
+  walked_data = NULL;
+}
+
+LMSampler::~LMSampler()
+{
+  free_hash(structs);
+  for (map<struct_en, int, comps_entries>::iterator it=output.begin(); it!=output.end(); it++) free(it->first.structure);
+}
+
+void LMSampler::Bound(int max_num, int range)
+{
+  retention.on = true;
+  retention.max_num = max_num;
+  retention.range = range;
+}
+
+void LMSampler::Saturate(double threshold, int min_samples)
+{
+  saturation.on = true;
+  saturation.threshold = threshold;
+  saturation.min_samples = min_samples;
+  for (map<struct_en, int, comps_entries>::iterator it=output.begin(); it!=output.end(); it++) {
+    saturation.samples += it->second;
+    if (it->second == 1) saturation.singletons++;
+  }
+}
+
+bool LMSampler::Saturated()
+{
+  return saturation.on && saturation.samples >= saturation.min_samples && saturation.singletons < saturation.threshold*saturation.samples;
+}
+
+// a sample descended into a minimum that had "hits" hits before
+inline void LMSampler::SaturationHit(int hits)
+{
+  saturation.samples++;
+  if (hits == 0) saturation.singletons++;
+  if (hits == 1) saturation.singletons--;
+}
+
+// evict minima from output that are out of bounds
+void LMSampler::RetainBound()
+{
+  while (!output.empty()) {
+    map<struct_en, int, comps_entries>::iterator last = output.end();
+    last--;
+
+    int cutoff = INT_MAX;
+    // too far from the lowest:
+    if (retention.range != INT_MAX && last->first.energy - output.begin()->first.energy > retention.range) {
+      cutoff = output.begin()->first.energy + retention.range;
+    } else {
+      // too many (whole group of the same energy has to go):
+      if (retention.max_num == 0 || (int)output.size() <= retention.max_num) break;
+      map<struct_en, int, comps_entries>::iterator it = last;
+      int group = 1;
+      while (it != output.begin()) {
+        it--;
+        if (it->first.energy != last->first.energy) break;
+        group++;
+      }
+      if ((int)output.size() - group < retention.max_num) break;
+      cutoff = last->first.energy - 1;
+    }
+
+    // evict all above cutoff
+    retention.cutoff = min(retention.cutoff, cutoff);
+    while (!output.empty()) {
+      last = output.end();
+      last--;
+      if (last->first.energy <= retention.cutoff) break;
+      retention.evicted++;
+      retention.hits += last->second;
+      if (last->second == 1) saturation.singletons--;
+      free(last->first.structure);
+      output.erase(last);
+    }
+  }
+}
+
+// remove hash entries of samples that descended into evicted minima (amortized - only after the hash doubled)
+void LMSampler::RetainPurge()
+{
+  if ((int)structs.size() < 2*retention.purged_at) return;
+  long long rest = purge_hash(structs, retention.cutoff);
+  if (!saturation.on) retention.hits += rest;
+  retention.purged_at = max((int)structs.size(), 1<<16);
+}
+
+int LMSampler::Add(LMContext &ctx, struct_en &str)
+{
+  // check if it was before
+  unordered_map<struct_en, gw_struct, hash_fncts, hash_eq>::iterator it_s = structs.find(str);
+
+  // if it was - release memory + get another
+  if (it_s != structs.end()) {
+    it_s->second.count++;
+    free(str.structure);
+    // count the hit right now
+    if (saturation.on) {
+      const struct_en &he = it_s->second.he;
+      if (retention.on && he.energy > retention.cutoff) {
+        retention.hits++;
+        saturation.samples++;
+      } else {
+        map<struct_en, int, comps_entries>::iterator it = output.find(he);
+        SaturationHit(it->second);
+        it->second++;
+      }
+    }
+    return 0;
+  }
+
+  //is it canonical (noLP)
+  if (ctx.walk.noLP && find_lone_pair(str.structure)!=-1) {
+    if (ctx.walk.verbose>0) fprintf(stderr, "WARNING: structure \"%s\" has lone pairs, skipping...\n", pt_to_str_pk(str.structure).c_str());
+    if (walked) walked(str, NULL, walked_data);
+    free(str.structure);
+    return -2;
+  }
+
+  // copy it anew
+  struct_en old = str;
+  str.structure = allocopy(str.structure);
+
+  //debugging
+  if (ctx.walk.verbose>1) fprintf(stderr, "processing: %d %s\n", (int)structs.size(), pt_to_str_pk(str.structure).c_str());
+
+  // descend
+  lm_descend(ctx, str);
+  // only some types of PK allowed!!!
+  if (ctx.walk.pknots && str.energy == INT_MAX) {
+    if (walked) walked(old, NULL, walked_data);
+    free(str.structure);
+    free(old.structure);
+    return 0;
+  }
+
+  // insert into hash (memory is here only on left side)
+  gw_struct &lm = structs[old];
+  lm.count = 1;
+
+  if (ctx.walk.verbose>2) fprintf(stderr, "\n  %s %d\n", pt_to_str_pk(str.structure).c_str(), str.energy);
+
+  // save for output
+  map<struct_en, int, comps_entries>::iterator it;
+  if (retention.on && str.energy > retention.cutoff) {
+    // minimum is out of bounds - just count it
+    retention.hits++;
+    if (saturation.on) saturation.samples++;
+    lm.he = str;
+    lm.he.structure = NULL;
+    free(str.structure);
+  } else if ((it = output.find(str)) != output.end()) {
+    if (saturation.on) SaturationHit(it->second);
+    it->second++;
+    lm.he = it->first;
+    free(str.structure);
+    if (walked) walked(old, it->first.structure, walked_data);
+  } else {
+    lm.he = str;
+    output.insert(make_pair(str, 1));
+    if (saturation.on) SaturationHit(0);
+    if (walked) walked(old, str.structure, walked_data);
+    if (retention.on) RetainBound();
+  }
+
+  if (retention.on) RetainPurge();
+  return 1;
+}
+
+int LMSampler::AddAll(LMContext &ctx, vector<struct_en> &uniq, vector<int> &counts)
+{
+  int num = uniq.size();
+
+  // walk (in parallel)
+  vector<struct_en> lms;  // local minima (NULL = skipped)
+  lm_descend_all(ctx, uniq, lms);
+
+  // fold into hash and output (serially, in order - as Add() would do)
+  int not_canonical = 0;
+  for (int i=0; i<num; i++) {
+    if (ctx.walk.noLP && find_lone_pair(uniq[i].structure)!=-1) {
+      if (ctx.walk.verbose>0) fprintf(stderr, "WARNING: structure \"%s\" has lone pairs, skipping...\n", pt_to_str_pk(uniq[i].structure).c_str());
+      not_canonical += counts[i];
+      free(uniq[i].structure);
+      continue;
+    }
+    if (lms[i].structure == NULL) {
+      free(uniq[i].structure);
+      continue;
+    }
+
+    // insert into hash (memory is here only on left side), rest of the counts is added in Tally()
+    gw_struct &lm = structs[uniq[i]];
+    lm.count = counts[i];
+
+    if (ctx.walk.verbose>2) fprintf(stderr, "\n  %s %d\n", pt_to_str_pk(lms[i].structure).c_str(), lms[i].energy);
+
+    // save for output
+    map<struct_en, int, comps_entries>::iterator it;
+    if (retention.on && lms[i].energy > retention.cutoff) {
+      // minimum is out of bounds - just count it
+      retention.hits++;
+      lm.he = lms[i];
+      lm.he.structure = NULL;
+      free(lms[i].structure);
+    } else if ((it = output.find(lms[i])) != output.end()) {
+      it->second++;
+      lm.he = it->first;
+      free(lms[i].structure);
+      if (walked) walked(uniq[i], it->first.structure, walked_data);
+    } else {
+      lm.he = lms[i];
+      output.insert(make_pair(lms[i], 1));
+      if (walked) walked(uniq[i], lms[i].structure, walked_data);
+      if (retention.on) RetainBound();
+    }
+  }
+
+  return not_canonical;
+}
+
+void LMSampler::Tally()
+{
+  // with saturation the hits are counted already
+  if (!saturation.on) retention.hits += add_stats(structs, output, retention.cutoff);
+}
+
+struct_en *lm_flood(LMContext &ctx, const struct_en &lm, int &saddle, int flood_max, int maxh, bool minh_total)
+{
+  return flood(lm, ctx.sqi, ctx.walk, saddle, flood_max, maxh, minh_total, ctx.stats);
+}
+
+int lm_saddle(LMContext &ctx, const char *str1, const char *str2, int depth)
+{
+  PROF_START(prof_time);
+  int saddle = ctx.walk.pknots? find_saddle_pk(ctx.sqi.seq, str1, str2, depth):find_saddle(ctx.sqi.seq, str1, str2, depth);
+  PROF_STOP(PROF_SADDLE, prof_time);
+  return saddle;
+}
+
+LMSaddleParams::LMSaddleParams()
+{
+  flood_portion = 0.95;
+  depth = 10;
+  flood_max = 1000;
+  minh = 0;
+  verbose = 0;
+}
+
+int lm_saddles(LMContext &ctx, vector<struct_en> &minima, vector<int> &counts, const LMSaddleParams &par, float *&energy_barr, bool *&findpath_barr, LMSaddleProgress *prog)
+{
+  clock_t clck1 = clock();
+  if (ctx.stats) ctx.stats->Phase(ST_FLOOD);
+  int num = minima.size();
+
+  vector<string> strs(num);
+  for (int i=0; i<num; i++) strs[i] = pt_to_str_pk(minima[i].structure);
+
+  // threshold for flooding
+  int threshold = 0;
+  if (num>0) {
+    vector<int> tmp = counts;
+    sort(tmp.begin(), tmp.end());
+    int thr = num*par.flood_portion;
+    thr--;
+    threshold = (thr<0 ? 0 : tmp[thr]);
+  }
+
+  bool resumed = (prog && energy_barr != NULL);
+  if (!resumed) {
+    size_t size = (size_t)num*num;
+    energy_barr = (float*) malloc(size*sizeof(float));
+    for (size_t i=0; i<size; i++) energy_barr[i]=1e10;
+    findpath_barr = (bool*) malloc(size*sizeof(bool));
+    for (size_t i=0; i<size; i++) findpath_barr[i]=false;
+  }
+
+  int flooded = (resumed ? prog->flooded : 0);
+  time_t last_save = time(NULL);
+  // union-find set of minima joined by flooding
+  UnionFind uf(num);
+  // minima flooded before resume (find() gives the lowest label, so the order of unions does not matter)
+  if (resumed) {
+    for (int i=0; i<num; i++) {
+      for (int j=i+1; j<num; j++) {
+        if (!findpath_barr[(size_t)i*num+j] && energy_barr[(size_t)i*num+j]<RATES_NO_SADDLE) uf.Union(i, j);
+      }
+    }
+  }
+  // first try to flood the highest bins
+  int flood_start = (resumed ? prog->flood_next : num-1);
+  for (int i=flood_start; i>=0; i--) {
+    // flood only if low number of walks ended there
+    if (counts[i]<=threshold && par.flood_max>0) {
+      if (par.verbose>2) fprintf(stderr,   "flooding  (%3d): %s %.2f\n", i+1, strs[i].c_str(), minima[i].energy/100.0);
+
+      int saddle;
+      struct_en *he = lm_flood(ctx, minima[i], saddle, par.flood_max, par.minh);
+
+      // print info
+      if (par.verbose>1) {
+        if (he) {
+          fprintf(stderr, "below     (%3d): %s %.2f\n"
+                          "en: %7.2f  is: %s %.2f\n", i,
+                  strs[i].c_str(), minima[i].energy/100.0, saddle/100.0,
+                  pt_to_str_pk(he->structure).c_str(), he->energy/100.0);
+        } else {
+          fprintf(stderr, "unsucesful(%3d): %s %.2f\n", i,
+                  strs[i].c_str(), minima[i].energy/100.0);
+        }
+      }
+      // if flood succesfull - walk down to find father minima
+      if (he) {
+        // walk down
+        lm_descend(ctx, *he);
+
+        // now check if we have the minimum already (hopefuly yes ;-) )
+        vector<struct_en>::iterator it;
+        it = lower_bound(minima.begin(), minima.end(), *he, compf_entries2);
+
+        if (par.verbose>1) fprintf(stderr, "minimum: %s %.2f\n", pt_to_str_pk(he->structure).c_str(), he->energy/100.0);
+        // we dont need it again
+
+        hash_eq heq;
+        if (it!=minima.end() && heq(&*it, he)) {
+          int pos = (int)(it-minima.begin());
+          if (par.verbose>1) fprintf(stderr, "found father at pos: %d\n", pos);
+
+          flooded++;
+          energy_barr[(size_t)i*num+pos] = energy_barr[(size_t)pos*num+i] = saddle/100.0;
+
+          // union set
+          uf.Union(min(i, pos), max(i, pos));
+        }
+        free(he->structure);
+        free(he);
+      }
+    }
+
+    if (prog) {
+      prog->flood_next = i-1;
+      prog->flooded = flooded;
+      if (prog->save && time(NULL)-last_save >= prog->interval) {
+        prog->save(*prog, energy_barr, findpath_barr, prog->data);
+        last_save = time(NULL);
+      }
+    }
+  }
+  if (prog && flood_start != -1) {
+    prog->flood_next = -1;
+    prog->flooded = flooded;
+    if (prog->save) prog->save(*prog, energy_barr, findpath_barr, prog->data);
+    last_save = time(NULL);
+  }
+
+  // time?
+  if (par.verbose>0) {
+    fprintf(stderr, "Flood(%d(%d)/%d): %.2f secs.\n", flooded, (int)(num*par.flood_portion), num, (clock() - clck1)/(double)CLOCKS_PER_SEC);
+    clck1 = clock();
+  }
+  if (ctx.stats) ctx.stats->Phase(ST_FINDPATH);
+
+  // for others, just do findpath
+  int findpath = 0;
+  set<int> to_findpath;
+  for (int i=0; i<num; i++) to_findpath.insert(uf.Find(i));
+
+  if (par.verbose>1) {
+    fprintf(stderr, "Minima left to findpath (their father = -1): ");
+    for (set<int>::iterator it=to_findpath.begin(); it!=to_findpath.end(); it++) {
+      fprintf(stderr, "%d ", *it);
+    }
+    fprintf(stderr, "\n");
+  }
+
+  // findpath:
+  for (set<int>::iterator it=to_findpath.begin(); it!=to_findpath.end(); it++) {
+    set<int>::iterator it2=it;
+    it2++;
+    for (; it2!=to_findpath.end(); it2++) {
+      // done before resume
+      if (findpath_barr[(size_t)(*it)*num+(*it2)]) {
+        if (ctx.stats) ctx.stats->findpath_known++;
+        continue;
+      }
+      energy_barr[(size_t)(*it2)*num+(*it)] = energy_barr[(size_t)(*it)*num+(*it2)] = lm_saddle(ctx, strs[*it].c_str(), strs[*it2].c_str(), par.depth)/100.0;
+      findpath_barr[(size_t)(*it2)*num+(*it)] = findpath_barr[(size_t)(*it)*num+(*it2)] = true;
+      if (par.verbose>0 && findpath %10000==0){
+        fprintf(stderr, "Findpath:%7d/%7d\n", findpath, (int)(to_findpath.size()*(to_findpath.size()-1)/2));
+      }
+      findpath++;
+      if (prog && prog->save && time(NULL)-last_save >= prog->interval) {
+        prog->save(*prog, energy_barr, findpath_barr, prog->data);
+        last_save = time(NULL);
+      }
+    }
+  }
+
+  // debug output
+  if (par.verbose>2) {
+    fprintf(stderr, "Energy barriers:\n");
+    for (int i=0; i<num; i++) {
+      for (int j=0; j<num; j++) {
+        fprintf(stderr, "%8.2g%c ", energy_barr[(size_t)i*num+j], (findpath_barr[(size_t)i*num+j]?'~':' '));
+      }
+      fprintf(stderr, "\n");
+    }
+    fprintf(stderr, "\n");
+  }
+
+  if (ctx.stats) ctx.stats->findpath_pairs += findpath;
+
+  // time?
+  if (par.verbose>0) {
+    fprintf(stderr, "Findpath(%d/%d): %.2f secs.\n", findpath, num*(num-1)/2, (clock() - clck1)/(double)CLOCKS_PER_SEC);
+  }
+
+  return flooded;
+}
+
+void lm_tree(int num, float *energy_barr, bool *findpath_barr, vector<int> &energies, nodeT *nodes)
+{
+  // fill nodes
+  for (int i=0; i<num; i++) {
+    nodes[i].father = -1;
+    nodes[i].height = energies[i]/100.0;
+    nodes[i].label = NULL;
+    nodes[i].color = 0.0;
+    nodes[i].saddle_height = 1e10;
+  }
+
+  // make tree (fill missing nodes)
+  make_tree(num, energy_barr, findpath_barr, nodes);
+}
+
+void lm_rates(double temp, int num, float *energy_barr, vector<int> &energies, vector<double> &rates)
+{
+  rates.resize((size_t)num*num);
+  if (num>0) compute_rates(0.00198717*(273.15 + temp), num, energy_barr, energies, &rates[0]);
+}
+
+void lm_rates_sparse(double temp, int num, float *energy_barr, vector<int> &energies, vector<int64_t> &row_ptr, vector<int> &col, vector<double> &val)
+{
+  double _kT = 0.00198717*(273.15 + temp);
+  row_ptr.assign(num+1, 0);
+  col.clear();
+  val.clear();
+  for (int i=0; i<num; i++) {
+    double en_i = energies[i]/100.0;
+    float *barr = energy_barr+(size_t)i*num;
+    for (int j=0; j<num; j++) {
+      if (i!=j && barr[j]<RATES_NO_SADDLE) {
+        col.push_back(j);
+        val.push_back(exp(-(barr[j]-en_i)/_kT));
+      }
+    }
+    row_ptr[i+1] = col.size();
+  }
+}
@@ -0,0 +1,151 @@
+#ifndef __LIBRNALOCMIN_H
+#define __LIBRNALOCMIN_H
+
+#include <stdint.h>
+#include <limits.h>
+
+#include <vector>
+#include <string>
+#include <map>
+#include <unordered_map>
+
+#include "globals.h"
+#include "hash_util.h"
+#include "treeplot.h"
+
+// in-memory interface to the RNAlocmin pipeline (gradient walks, flooding, saddles, barrier tree, rates)
+//  energy parameters (temperature, dangles, read_parameter_file()) are process-wide, set them before the first context is created
+//  walk method and move set are in the context (main copies them from the command line), the rest is passed in calls
+//  lm_descend() and lm_descend_all() may be called concurrently on one context (not with walk.neighs),
+//  flooding reuses one process-wide hash and findpath keeps its state in ViennaRNA globals - call them from one thread only
+
+class RunStats;
+
+// sequence context (sequence and its encodings shared by all calls, walk and move set options)
+class LMContext {
+public:
+  SeqInfo sqi;
+  WalkOpts walk;
+  RunStats *stats;  // where to count walks, floods and phases (--stats-json), NULL = nowhere
+
+  LMContext(const char *seq, const WalkOpts &walk = WalkOpts());
+};
+
+// energy of a structure (pair table) in dcal/mol
+int lm_energy(LMContext &ctx, short *pt);
+
+// walk str down to its local minimum (in place), str.energy has to be the energy of str.structure
+//  returns energy of the minimum (INT_MAX with pknots if the structure is outside of the model),
+//  the number of moves goes to *length (-1 for walks with pknots)
+int lm_descend(LMContext &ctx, struct_en &str, int *length = NULL);
+
+// walk all structures down (in parallel, in lexicographic order for locality)
+//  energy of strs[i] is computed if it is INT_MAX
+//  lms[i] is the minimum of strs[i], its structure is NULL if strs[i] has lone pairs (with walk.noLP) or is outside of the pknot model
+void lm_descend_all(LMContext &ctx, std::vector<struct_en> &strs, std::vector<struct_en> &lms);
+
+// sampling (structures e.g. from RNAsubopt): every structure is walked down once, repeated ones are only counted
+//  structs - walked structures -> their minimum (memory of the minimum belongs to output) and number of occurrences
+//  output  - minima -> number of samples that descended into them (repeated samples are added by Tally(), at once with saturation)
+class LMSampler {
+public:
+  std::unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> structs;
+  std::map<struct_en, int, comps_entries> output;
+
+  // bounded retention of minima (Bound()): output keeps only the lowest minima while sampling
+  //  evictions only lower the cutoff, so a minimum is in output iff its energy is <= cutoff
+  //  (entries of structs pointing to minima above cutoff are not dereferenced, they are only counted)
+  struct Retention {
+    bool on;
+    int max_num;    // keep at most this many minima (+ ties), 0 = unlimited
+    int range;      // keep only minima within this range from the lowest one (in dcal/mol), INT_MAX = unlimited
+    int cutoff;     // minima above this energy have been evicted
+    int evicted;    // number of evicted minima
+    long long hits; // number of samples that descended into evicted minima
+    int purged_at;  // size of the hash after its last purge
+  } retention;
+
+  // discovery saturation (Saturate()): Good-Turing estimate of unseen probability mass
+  //  (number of minima hit exactly once / number of samples), hits of repeated samples go directly to output then,
+  //  so singletons are known all the time
+  struct Saturation {
+    bool on;
+    double threshold;
+    int min_samples;    // do not stop before this many samples
+    long long samples;  // number of samples that descended into a minimum
+    int singletons;     // number of minima hit exactly once
+  } saturation;
+
+  // called with every newly walked sample and its minimum in output (NULL if the sample is skipped), e.g. for --allegiance
+  void (*walked)(const struct_en &str, const short *lm, void *data);
+  void *walked_data;
+
+  LMSampler(int hash_size = HASHSIZE);
+  // frees walked structures and minima left in output
+  ~LMSampler();
+
+  // keep at most max_num lowest minima (0 = unlimited) and minima within range (dcal/mol, INT_MAX = unlimited) from the lowest one
+  void Bound(int max_num, int range);
+  // Saturated() once the estimate drops below threshold (not before min_samples), minima already in output count as hits
+  void Saturate(double threshold, int min_samples);
+  bool Saturated();
+
+  // one sample (its structure is taken), str.energy has to be the energy of str.structure
+  //  returns 1 if it was walked, 0 if it is known already or outside of the pknot model, -2 if it has lone pairs (with walk.noLP)
+  int Add(LMContext &ctx, struct_en &str);
+  // unique samples with their numbers of occurrences (structures are taken, energy INT_MAX is computed), walked in parallel
+  //  and added in order, returns number of samples with lone pairs (with walk.noLP)
+  int AddAll(LMContext &ctx, std::vector<struct_en> &uniq, std::vector<int> &counts);
+  // add hits of repeated samples to output (at the end of sampling)
+  void Tally();
+
+private:
+  void SaturationHit(int hits);
+  void RetainBound();
+  void RetainPurge();
+};
+
+// flood the basin of minimum lm up to maxh (0 = unlimited) and flood_max structures, returns structure below the saddle (to be freed) or NULL
+struct_en *lm_flood(LMContext &ctx, const struct_en &lm, int &saddle, int flood_max, int maxh = 0, bool minh_total = false);
+
+// saddle height between two structures (dot-bracket) by findpath with given depth, in dcal/mol
+int lm_saddle(LMContext &ctx, const char *str1, const char *str2, int depth);
+
+// progress of lm_saddles (for checkpoints), save is called at most once per interval seconds and when flooding is done
+//  flooding goes from the last minimum down, then findpath fills the pairs left
+struct LMSaddleProgress {
+  int flood_next;   // next minimum to flood (-1 = flooding done)
+  int flooded;      // successfully flooded so far
+  int interval;
+  void (*save)(LMSaddleProgress &prog, float *energy_barr, bool *findpath_barr, void *data);
+  void *data;
+};
+
+// settings of lm_saddles (the constructor sets the defaults of --floodPortion, --depth, --floodMax and --minh, quiet)
+struct LMSaddleParams {
+  double flood_portion; // portion of minima (with the lowest numbers of hits) to flood
+  int depth;            // depth of findpath search
+  int flood_max;        // maximal number of structures in one flood (0 = do not flood)
+  int minh;             // flood only up to this height (dcal/mol, 0 = unlimited)
+  int verbose;
+
+  LMSaddleParams();
+};
+
+// energy barriers between minima (sorted by energy): minima with low number of hits (flood_portion of them) are flooded,
+//  findpath is done between the rest, energy_barr (num*num, kcal/mol, 1e10 = unknown) and findpath_barr (num*num) are allocated here
+//  with prog and energy_barr/findpath_barr already allocated (saved by prog->save) continues where prog stopped
+//  returns number of successfully flooded minima
+int lm_saddles(LMContext &ctx, std::vector<struct_en> &minima, std::vector<int> &counts, const LMSaddleParams &par, float *&energy_barr, bool *&findpath_barr, LMSaddleProgress *prog = NULL);
+
+// barrier tree from energy barriers (nodes has num elements)
+void lm_tree(int num, float *energy_barr, bool *findpath_barr, std::vector<int> &energies, nodeT *nodes);
+
+// Arrhenius rates (rates[i*num+j] is rate i->j) at temperature temp (in Celsius), dense - num*num doubles
+void lm_rates(double temp, int num, float *energy_barr, std::vector<int> &energies, std::vector<double> &rates);
+
+// the same in CSR (as in --rates-bin): row i has rates i->col[k] val[k] for k = row_ptr[i] .. row_ptr[i+1]-1,
+//  only pairs with a computed saddle are stored (others have rate 0)
+void lm_rates_sparse(double temp, int num, float *energy_barr, std::vector<int> &energies, std::vector<int64_t> &row_ptr, std::vector<int> &col, std::vector<double> &val);
+
+#endif
@@ -4,6 +4,8 @@
 #include <time.h>
 #include <limits.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include <string>
 #include <set>
@@ -28,22 +30,96 @@ extern "C" {
 #include "globals.h"
 #include "RNAlocmin.h"
 #include "flood.h"
+#include "profile.h"
 #include "RNAlocmin.h"
 #include "move_set_pk.h"
 #include "neighbourhood.h"
 
 #include "barrier_tree.h"
+#include "kinetics.h"
+#include "librnalocmin.h"
+#include "run_stats.h"
+#include "server.h"
+#include "checkpoint.h"
+#include "shard.h"
+#include "allegiance.h"
 
 using namespace std;
 
-// dirty hack to "allegiance" stuff
- //to be filled by 1st run
-map<struct_en, struct_en, comps_entries> str_to_LM;
-vector<struct_en> structures;
- // to be filled after
-map<struct_en, int, comps_entries> LM_to_LMnum;
-static bool allegiance = false;
+// allegiance of samples to minima (--allegiance)
+static Allegiance allegiance;
 
+// lines read from stdin (to skip them on --resume if stdin cannot be seeked)
+static long long input_lines = 0;
+
+// allegiance of a newly walked sample (lm = its minimum, NULL if skipped)
+void allegiance_walked(const struct_en &str, const short *lm, void *data)
+{
+  allegiance.Sample(str, (lm ? allegiance.Id(lm) : -1));
+}
+
+// state of the run for a checkpoint
+void checkpoint_info(CheckpointInfo &info, LMSampler &sampler, int not_canonical)
+{
+  LMSampler::Retention &retention = sampler.retention;
+  LMSampler::Saturation &saturation = sampler.saturation;
+  info.offset = ftell(stdin);
+  info.lines = input_lines;
+  info.num_moves = num_moves;
+  info.not_canonical = not_canonical;
+  info.sat_samples = saturation.samples;
+  info.sat_singletons = saturation.singletons;
+  info.ret_cutoff = retention.cutoff;
+  info.ret_evicted = retention.evicted;
+  info.ret_hits = retention.hits;
+  info.ret_purged_at = retention.purged_at;
+}
+
+// continue the run from checkpoint info (sampling phase also repositions stdin)
+void checkpoint_restore(CheckpointInfo &info, LMSampler &sampler, int &not_canonical)
+{
+  LMSampler::Retention &retention = sampler.retention;
+  LMSampler::Saturation &saturation = sampler.saturation;
+  num_moves = info.num_moves;
+  not_canonical = info.not_canonical;
+  saturation.samples = info.sat_samples;
+  saturation.singletons = info.sat_singletons;
+  retention.cutoff = info.ret_cutoff;
+  retention.evicted = info.ret_evicted;
+  retention.hits = info.ret_hits;
+  retention.purged_at = info.ret_purged_at;
+
+  if (info.phase != CHK_SAMPLING) return;
+  if (info.offset >= 0 && fseek(stdin, info.offset, SEEK_SET) == 0) {
+    input_lines = info.lines;
+    return;
+  }
+  // input from pipe - skip what was read already
+  char *line;
+  while (input_lines < info.lines && (line = my_getline(stdin)) != NULL) {
+    input_lines++;
+    free(line);
+  }
+  if (input_lines < info.lines) fprintf(stderr, "WARNING: input is shorter than at the checkpoint (%lld lines read, %lld expected)\n", input_lines, info.lines);
+}
+
+// checkpoint of the saddle phase (called from lm_saddles)
+struct SaddleCheckpoint {
+  const char *filename;
+  const char *seq;
+  CheckpointInfo *info;
+  vector<struct_en> *minima;
+  vector<int> *counts;
+};
+
+void checkpoint_saddles(LMSaddleProgress &prog, float *energy_barr, bool *findpath_barr, void *data)
+{
+  SaddleCheckpoint &sc = *(SaddleCheckpoint*)data;
+  sc.info->flood_next = prog.flood_next;
+  sc.info->flooded = prog.flooded;
+  checkpoint_save_saddles(sc.filename, sc.seq, *sc.info, *sc.minima, *sc.counts, energy_barr, findpath_barr);
+  if (Opt.verbose_lvl>0) fprintf(stderr, "Checkpoint (saddles): %s\n", sc.filename);
+}
 
 inline bool isSeq(char *p)
 {
@@ -103,13 +179,16 @@ struct barr_info { // info taken from barriers
 
 // functions that are down in file ;-)
 char *read_seq(char *seq_arg, char **name_out);
-int move(unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> &structs, map<struct_en, int, comps_entries> &output, set<struct_en, comps_entries> &output_shallow, SeqInfo &sqi, bool pure_output);
+int batch_run(gengetopt_args_info &args_info, char **seq_out, char **name_out);
+int move(LMSampler &sampler, LMContext &ctx, bool pure_output);
+int move_batch(LMSampler &sampler, LMContext &ctx);
 char *read_previous(char *previous, map<struct_en, int, comps_entries> &output);
 char *read_barr(char *previous, map<struct_en, barr_info, comps_entries> &output);
 
 int main(int argc, char **argv)
 {
   clock_t clck1 = clock();
+  PROF_INIT();
 
   // testing
   //test();
@@ -147,8 +226,10 @@ int main(int argc, char **argv)
   }
 
   // adjust dependencies:
-  if (args_info.barr_name_given) {args_info.bartree_flag = true;}
+  if (args_info.barr_name_given || args_info.tree_newick_given || args_info.tree_json_given) {args_info.bartree_flag = true;}
   if (args_info.rates_file_given) {args_info.rates_flag = true;}
+  if (args_info.temp_list_given || args_info.kT_list_given) {args_info.rates_flag = true;}
+  if (args_info.server_socket_given) {args_info.server_flag = true;}
 
   // degeneracy setup
   if (args_info.degeneracy_off_flag) {
@@ -159,15 +240,48 @@ int main(int argc, char **argv)
   //try_pk();
   //exit(0);
 
-  // keep track of structures & statistics
-  map<struct_en, int, comps_entries> output; // structures plus energies to output (+ how many hits has this minima)
-  map<struct_en, barr_info, comps_entries> output_barr; // structures plus energies to output (+ barr_info)
-  set<struct_en, comps_entries> output_shallow; // shallow structures (if minh specified)
+  // server mode: queries instead of input structures
+  if (args_info.server_flag) {
+    char *seq = NULL;
+    char *name = NULL;
+    if (args_info.seq_given) seq = read_seq(args_info.seq_arg, &name);
+    int ret = server_run(args_info, seq);
+    if (seq) free(seq);
+    if (name) free(name);
+    cmdline_parser_free(&args_info);
+    return ret;
+  }
+
+  // batch mode: workers continue with their sequence, parent ends here
   char *seq = NULL;
   char *name = NULL;
+  if (args_info.batch_given) {
+    int ret = batch_run(args_info, &seq, &name);
+    if (ret != -1) {
+      cmdline_parser_free(&args_info);
+      return ret;
+    }
+  }
+
+  // keep track of structures & statistics
+  LMSampler sampler(args_info.batch_given || args_info.fix_barriers_given ? 1024 : HASHSIZE); // walked structures (short sequences in batch - let the hash grow)
+  map<struct_en, int, comps_entries> &output = sampler.output; // structures plus energies to output (+ how many hits has this minima)
+  map<struct_en, barr_info, comps_entries> output_barr; // structures plus energies to output (+ barr_info)
+  unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> merged_structs; // walked structures from shards (--merge with --shard-assign)
+  vector<shard_saddle> merged_saddles; // saddles from shards (--merge)
 
   // read previous LM or/and sequence
-  if (args_info.fix_barriers_given) {
+  if (seq != NULL) {
+    // already have it from batch
+  } else if (args_info.resume_flag) {
+    // minima from --previous are in the checkpoint too
+    seq = checkpoint_seq(args_info.checkpoint_arg);
+    if (seq == NULL) exit(EXIT_FAILURE);
+  } else if (args_info.merge_given) {
+    seq = shard_merge(args_info.merge_given, args_info.merge_arg, output, (args_info.shard_assign_flag ? &merged_structs : NULL), merged_saddles);
+    if (seq == NULL) exit(EXIT_FAILURE);
+    if (args_info.verbose_lvl_arg>0) fprintf(stderr, "Merged %d shards: %d minima, %d saddles\n", (int)args_info.merge_given, (int)output.size(), (int)merged_saddles.size());
+  } else if (args_info.fix_barriers_given) {
     seq = read_barr(args_info.fix_barriers_arg, output_barr);
   } else {
     if (args_info.previous_given) {
@@ -181,15 +295,14 @@ int main(int argc, char **argv)
 
   seq_len = strlen(seq);
 
+  // discovery saturation (minima from --previous count as hits too):
+  if (args_info.saturation_given) sampler.Saturate(args_info.saturation_arg, args_info.saturation_min_arg);
+
+  // bounded retention:
+  if (args_info.bounded_flag) sampler.Bound((Opt.minh == 0 ? args_info.min_num_arg : 0), (args_info.eRange_given ? (int)(args_info.eRange_arg*100)+1 : INT_MAX));
+
   // allegiance:
-  FILE *alleg = NULL;
-  if (args_info.allegiance_given) {
-    alleg = fopen(args_info.allegiance_arg, "w");
-    if (alleg) {
-      allegiance = true;
-      fprintf(alleg, "       %s\n", seq);
-    }
-  }
+  if (args_info.allegiance_given && allegiance.Open(args_info.allegiance_arg, seq)) sampler.walked = allegiance_walked;
 
   // time?
   if (args_info.verbose_lvl_arg>0) {
@@ -198,35 +311,83 @@ int main(int argc, char **argv)
   }
 
   // ########################## begin main loop - reads structures from RNAsubopt and process them
+  Stats.on = args_info.stats_json_given;
+  if (Stats.on) Stats.Phase(ST_SAMPLING);
   int count = max(output.size(), output_barr.size());  //num of local minima
-  SeqInfo sqi;
-  sqi.Init(seq);
+  LMContext ctx(seq, Opt.Walk());
+  if (Stats.on) ctx.stats = &Stats;
 
   int not_canonical = 0;
 
+  // checkpoints:
+  CheckpointInfo chk;
+  memset(&chk, 0, sizeof(CheckpointInfo));
+  vector<struct_en> chk_minima;  // minima and barriers from a checkpoint of saddle phase
+  vector<int> chk_counts;
+  float *chk_energy_barr = NULL;
+  bool *chk_findpath_barr = NULL;
+  time_t chk_last = time(NULL);
+
   if (!args_info.fix_barriers_given) {
 
     // if direct output:
     if (args_info.just_output_flag) printf("%s\n", seq);
 
     // hash
-    unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> structs (HASHSIZE); // structures to minima map
-    while ((!args_info.find_num_given || count != args_info.find_num_arg) && !args_info.just_read_flag) {
-      int res = move(structs, output, output_shallow, sqi, args_info.just_output_flag);
+    unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> &structs = sampler.structs; // structures to minima map
+
+    // resume:
+    if (args_info.resume_flag) {
+      for (map<struct_en, int, comps_entries>::iterator it=output.begin(); it!=output.end(); it++) free(it->first.structure);
+      output.clear();
+      char *chk_seq = checkpoint_load(args_info.checkpoint_arg, chk, structs, output, chk_minima, chk_counts, chk_energy_barr, chk_findpath_barr);
+      if (chk_seq == NULL) exit(EXIT_FAILURE);
+      free(chk_seq);
+      checkpoint_restore(chk, sampler, not_canonical);
+      // saddle phase - minima are already filtered, put them back for output
+      for (unsigned int i=0; i<chk_minima.size(); i++) output[chk_minima[i]] = chk_counts[i];
+      count = output.size();
+      if (Opt.verbose_lvl>0) fprintf(stderr, "Resumed from %s: %s phase, %d structures read, %d minima\n", args_info.checkpoint_arg, (chk.phase == CHK_SAMPLING ? "sampling" : "saddle"), num_moves, count);
+    }
+    if (args_info.two_phase_flag && !args_info.just_read_flag) {
+      not_canonical = move_batch(sampler, ctx);
+      count = output.size();
+    }
+    while (!args_info.two_phase_flag && chk.phase != CHK_SADDLES && !args_info.merge_given && (!args_info.find_num_given || count != args_info.find_num_arg) && !args_info.just_read_flag) {
+      int res = move(sampler, ctx, args_info.just_output_flag);
 
       // print out
       //if (Opt.verbose_lvl>0 && num_moves%10000==0) fprintf(stderr, "processed %d, minima %d, time %f secs.\n", num_moves, count, (clock()-clck1)/(double)CLOCKS_PER_SEC);
       if (Opt.verbose_lvl>0 && num_moves%(Opt.pknots?1000:10000)==0 && num_moves!=0) fprintf(stderr, "processed %d, minima %d, time %f secs.\n", num_moves, (int)output.size(), (clock()-clck1)/(double)CLOCKS_PER_SEC);
 
+      // checkpoint?
+      if (args_info.checkpoint_given && num_moves%1000==0 && time(NULL)-chk_last >= args_info.checkpoint_interval_arg) {
+        checkpoint_info(chk, sampler, not_canonical);
+        checkpoint_save_sampling(args_info.checkpoint_arg, seq, chk, structs, output);
+        chk_last = time(NULL);
+        if (Opt.verbose_lvl>0) fprintf(stderr, "Checkpoint (%d structures): %s\n", num_moves, args_info.checkpoint_arg);
+      }
+
       // evaluate results
       if (res==0)   continue; // same structure has been processed already
       if (res==-1)  break; // error or end
       if (res==-2)  not_canonical++;
       if (res==1)   count=output.size();
+
+      // enough samples?
+      if (res>=0 && sampler.Saturated()) {
+        fprintf(stderr, "Saturation reached after %d structures (%d minima, estimated unseen mass %.5f)\n", num_moves, (int)output.size(), sampler.saturation.singletons/(double)sampler.saturation.samples);
+        break;
+      }
     }
 
     if (args_info.just_output_flag) {
       // end it
+      if (Stats.on) {
+        Stats.samples = num_moves;
+        Stats.Phase(ST_NUM);
+        Stats.WriteJson(args_info.stats_json_arg);
+      }
 
       // release resources
       if (seq!=NULL) free(seq);
@@ -246,9 +407,33 @@ int main(int argc, char **argv)
 
     // ########################## end main loop - reads structures from RNAsubopt and process them
 
+    // whole input is read (flooding of shallow minima can take long yet)
+    if (args_info.checkpoint_given && chk.phase != CHK_SADDLES) {
+      checkpoint_info(chk, sampler, not_canonical);
+      checkpoint_save_sampling(args_info.checkpoint_arg, seq, chk, structs, output);
+    }
+
+    if (Stats.on) {
+      Stats.samples = num_moves;
+      Stats.unique = structs.size();
+      Stats.hash_size = structs.size();
+      Stats.hash_buckets = structs.bucket_count();
+      Stats.hash_max_load = structs.max_load_factor();
+      Stats.not_canonical = not_canonical;
+      Stats.Phase(ST_SHALLOW);
+    }
+
     //int num_of_structures = hash_size();
     if (args_info.verbose_lvl_arg>0) print_stats(structs);
-    add_stats(structs, output);
+    sampler.Tally();
+    if (sampler.retention.on) fprintf(stderr, "Bounded retention: %d minima evicted, %lld samples descended into minima out of bounds\n", sampler.retention.evicted, sampler.retention.hits);
+
+    // summary for merging
+    if (args_info.shard_out_given) {
+      unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> *assign = NULL;
+      if (args_info.shard_assign_flag) assign = (args_info.merge_given ? &merged_structs : &structs);
+      shard_write(args_info.shard_out_arg, seq, output, assign);
+    }
 
     // time?
     if (args_info.verbose_lvl_arg>0) {
@@ -269,19 +454,18 @@ int main(int argc, char **argv)
     vector<int> output_num;
     output_num.resize(num);
 
-    // threshold for flooding
-    int threshold;
-
+    vector<int> output_index(num); // index in output map (in shards)
+    vector<int> index_of_output(output.size(), -1);
     int i=0;
     int ii=0;
     for (map<struct_en, int, comps_entries>::iterator it=output.begin(); it!=output.end(); it++) {
       ii++;
       // if not enough minima
       if (i<num) {
-        // first check if the output is not shallow
-        if (Opt.minh>0) {
+        // first check if the output is not shallow (minima from a checkpoint of saddle phase are checked already)
+        if (Opt.minh>0 && chk.phase != CHK_SADDLES) {
           int saddle;
-          struct_en *escape = flood(it->first, sqi, saddle, Opt.minh, args_info.pseudoknots_flag, !args_info.minh_lite_flag);
+          struct_en *escape = lm_flood(ctx, it->first, saddle, Opt.floodMax, Opt.minh, !args_info.minh_lite_flag);
 
           if (args_info.verbose_lvl_arg>0 && ii%100 == 0) {
             fprintf(stderr, "non-shallow remained: %d / %d; time: %.2f secs.\n", i, ii, (clock()-clck1)/(double)CLOCKS_PER_SEC);
@@ -304,10 +488,12 @@ int main(int argc, char **argv)
         output_num[i]=it->second;
         output_he[i]=it->first;
         output_en[i]=it->first.energy;
+        output_index[i]=ii-1;
+        index_of_output[ii-1]=i;
         i++;
 
         // allegiance:
-        if (allegiance) LM_to_LMnum[it->first] = i;
+        if (allegiance.on) allegiance.Number(it->first.structure, i);
 
       } else { // we have enough minima
         free(it->first.structure);
@@ -316,15 +502,7 @@ int main(int argc, char **argv)
     output.clear();
 
     // allegiance:
-    if (allegiance) {
-      for (int i=0; i<(int)structures.size(); i++) {
-        fprintf(alleg, "%6d %s %6.2f %6d\n", i+1, pt_to_str_pk(structures[i].structure).c_str(), structures[i].energy/100.0, LM_to_LMnum[str_to_LM[structures[i]]]);
-        //free(structures[i].structure);
-      }
-      structures.clear();
-      LM_to_LMnum.clear();
-      str_to_LM.clear();
-    }
+    allegiance.Finish();
 
     // erase possible NULL elements...
     /*if (args_info.noSort_flag) {
@@ -341,7 +519,14 @@ int main(int argc, char **argv)
       output_str.resize(i);
       output_en.resize(i);
       output_num.resize(i);
+      output_index.resize(i);
     //}
+    num = i;
+    if (Stats.on) {
+      Stats.seq_len = strlen(seq);
+      Stats.minima = ii;
+      Stats.minima_out = num;
+    }
 
     // time?
     if (Opt.minh>0 && args_info.verbose_lvl_arg>0) {
@@ -354,143 +539,78 @@ int main(int argc, char **argv)
     bool *findpath_barr = NULL;
 
     // find saddles - fill energy barriers
-    if (args_info.rates_flag || args_info.bartree_flag || args_info.barrier_file_given) {
-      // threshold for flooding
-      vector<int> tmp = output_num;
-      sort(tmp.begin(), tmp.end());
-      int thr = num*args_info.floodPortion_arg;
-      thr--;
-      threshold = (thr<0 ? 0 : tmp[thr]);
-
+    if (args_info.rates_flag || args_info.bartree_flag || args_info.barrier_file_given || args_info.rates_bin_given || args_info.kinetics_given) {
       // nodes
       nodeT nodes[num];
-      energy_barr = (float*) malloc(num*num*sizeof(float));
-      for (int i=0; i<num*num; i++) energy_barr[i]=1e10;
-      findpath_barr = (bool*) malloc(num*num*sizeof(bool));
-      for (int i=0; i<num*num; i++) findpath_barr[i]=false;
-
-      // fill nodes
-      for (int i=0; i<num; i++) {
-        nodes[i].father = -1;
-        nodes[i].height = output_en[i]/100.0;
-        nodes[i].label = NULL;
-        nodes[i].color = 0.0;
-        nodes[i].saddle_height = 1e10;
-      }
-
-      int flooded = 0;
-      // init union-findset
-      init_union(num);
-      // first try to flood the highest bins
-      for (int i=num-1; i>=0; i--) {
-        // flood only if low number of walks ended there
-        if (output_num[i]<=threshold && Opt.floodMax>0) {
-          //copy_arr(Enc.pt, output_he[i].structure);
-          if (args_info.verbose_lvl_arg>2) fprintf(stderr,   "flooding  (%3d): %s %.2f\n", i+1, output_str[i].c_str(), output_he[i].energy/100.0);
 
-          int saddle;
-          struct_en *he = flood(output_he[i], sqi, saddle, Opt.minh, args_info.pseudoknots_flag);
-
-          // print info
-          if (args_info.verbose_lvl_arg>1) {
-            if (he) {
-              fprintf(stderr, "below     (%3d): %s %.2f\n"
-                              "en: %7.2f  is: %s %.2f\n", i,
-                      output_str[i].c_str(), output_he[i].energy/100.0, saddle/100.0,
-                      pt_to_str_pk(he->structure).c_str(), he->energy/100.0);
-            } else {
-              fprintf(stderr, "unsucesful(%3d): %s %.2f\n", i,
-                      output_str[i].c_str(), output_he[i].energy/100.0);
-            }
-          }
-          // if flood succesfull - walk down to find father minima
-          if (he) {
-            // walk down
-            move_set(*he, sqi);
-
-            // now check if we have the minimum already (hopefuly yes ;-) )
-            vector<struct_en>::iterator it;
-            it = lower_bound(output_he.begin(), output_he.end(), *he, compf_entries2);
-
-            if (args_info.verbose_lvl_arg>1) fprintf(stderr, "minimum: %s %.2f\n", pt_to_str_pk(he->structure).c_str(), he->energy/100.0);
-            // we dont need it again
-
-            hash_eq heq;
-            if (it!=output_he.end() && heq(&*it, he)) {
-              int pos = (int)(it-output_he.begin());
-              if (args_info.verbose_lvl_arg>1) fprintf(stderr, "found father at pos: %d\n", pos);
-
-              flooded++;
-              energy_barr[i*num+pos] = energy_barr[pos*num+i] = saddle/100.0;
-
-              // union set
-              //fprintf(stderr, "join: %d %d\n", min(i, pos), max(i, pos));
-              union_set(min(i, pos), max(i, pos));
-            }
-            free(he->structure);
-            free(he);
-          }
+      // checkpoints of flooding and findpath
+      LMSaddleProgress prog;
+      SaddleCheckpoint sc = {args_info.checkpoint_arg, seq, &chk, &output_he, &output_num};
+      prog.flood_next = num-1;
+      prog.flooded = 0;
+      prog.interval = args_info.checkpoint_interval_arg;
+      prog.save = (args_info.checkpoint_given ? checkpoint_saddles : NULL);
+      prog.data = &sc;
+      if (chk.phase == CHK_SADDLES) {
+        energy_barr = chk_energy_barr;
+        findpath_barr = chk_findpath_barr;
+        if (energy_barr) {
+          prog.flood_next = chk.flood_next;
+          prog.flooded = chk.flooded;
         }
+      } else if (args_info.checkpoint_given) {
+        checkpoint_info(chk, sampler, not_canonical);
+        checkpoint_saddles(prog, NULL, NULL, &sc);
       }
 
-      // time?
-      if (args_info.verbose_lvl_arg>0) {
-        fprintf(stderr, "Flood(%d(%d)/%d): %.2f secs.\n", flooded, (int)(num*args_info.floodPortion_arg), num, (clock() - clck1)/(double)CLOCKS_PER_SEC);
-        clck1 = clock();
-      }
-
-      // for others, just do findpath
-      int findpath = 0;
-      set<int> to_findpath;
-      for (int i=0; i<num; i++) to_findpath.insert(find(i));
-
-      if (args_info.verbose_lvl_arg>1) {
-        fprintf(stderr, "Minima left to findpath (their father = -1): ");
-        for (set<int>::iterator it=to_findpath.begin(); it!=to_findpath.end(); it++) {
-          fprintf(stderr, "%d ", *it);
+      // saddles known from shards - only the rest is flooded/findpathed
+      if (!merged_saddles.empty()) {
+        size_t size = (size_t)num*num;
+        energy_barr = (float*) malloc(size*sizeof(float));
+        for (size_t i=0; i<size; i++) energy_barr[i]=1e10;
+        findpath_barr = (bool*) malloc(size*sizeof(bool));
+        for (size_t i=0; i<size; i++) findpath_barr[i]=false;
+        for (unsigned int k=0; k<merged_saddles.size(); k++) {
+          int a = index_of_output[merged_saddles[k].i];
+          int b = index_of_output[merged_saddles[k].j];
+          if (a==-1 || b==-1) continue;
+          energy_barr[(size_t)a*num+b] = energy_barr[(size_t)b*num+a] = merged_saddles[k].saddle;
+          findpath_barr[(size_t)a*num+b] = findpath_barr[(size_t)b*num+a] = merged_saddles[k].findpath;
         }
-        fprintf(stderr, "\n");
       }
 
-      // findpath:
-      for (set<int>::iterator it=to_findpath.begin(); it!=to_findpath.end(); it++) {
-        set<int>::iterator it2=it;
-        it2++;
-        for (; it2!=to_findpath.end(); it2++) {
-          if (args_info.pseudoknots_flag) energy_barr[(*it2)*num+(*it)] = energy_barr[(*it)*num+(*it2)] = find_saddle_pk(seq, output_str[*it].c_str(), output_str[*it2].c_str(), args_info.depth_arg)/100.0;
-          else energy_barr[(*it2)*num+(*it)] = energy_barr[(*it)*num+(*it2)] = find_saddle(seq, output_str[*it].c_str(), output_str[*it2].c_str(), args_info.depth_arg)/100.0;
-          findpath_barr[(*it2)*num+(*it)] = findpath_barr[(*it)*num+(*it2)] = true;
-          if (args_info.verbose_lvl_arg>0 && findpath %10000==0){
-            fprintf(stderr, "Findpath:%7d/%7d\n", findpath, (int)(to_findpath.size()*(to_findpath.size()-1)/2));
-          }
-          findpath++;
-        }
-      }
+      // flood + findpath
+      LMSaddleParams par;
+      par.flood_portion = args_info.floodPortion_arg;
+      par.depth = args_info.depth_arg;
+      par.flood_max = Opt.floodMax;
+      par.minh = (int)Opt.minh;
+      par.verbose = Opt.verbose_lvl;
+      lm_saddles(ctx, output_he, output_num, par, energy_barr, findpath_barr, (args_info.checkpoint_given || energy_barr ? &prog : NULL));
+      if (args_info.shard_out_given) shard_append_saddles(args_info.shard_out_arg, num, energy_barr, findpath_barr, output_index);
+      if (Stats.on) Stats.Phase(ST_TREE);
+      clck1 = clock();
 
-      // debug output
-      if (args_info.verbose_lvl_arg>2) {
-        fprintf(stderr, "Energy barriers:\n");
-        //bool symmetric = true;
-        for (int i=0; i<num; i++) {
-          for (int j=0; j<num; j++) {
-            fprintf(stderr, "%8.2g%c ", energy_barr[i*num+j], (findpath_barr[i*num+j]?'~':' '));
-            //if (energy_barr[i*num+j] != energy_barr[j*num+i]) symmetric = false;
-          }
-          fprintf(stderr, "\n");
-        }
-        fprintf(stderr, "\n");
-        //fprintf(stderr, "%s", (symmetric? "":"non-symmetric energy barriers!!\n"));
+      // create rates for treekin
+      if (args_info.rates_flag) {
+        print_rates(args_info.rates_file_arg, args_info.temp_arg, num, energy_barr, output_en);
+        if (args_info.temp_list_given) print_rates_multi(args_info.rates_file_arg, args_info.temp_list_given, args_info.temp_list_arg, false, num, energy_barr, output_en);
+        if (args_info.kT_list_given) print_rates_multi(args_info.rates_file_arg, args_info.kT_list_given, args_info.kT_list_arg, true, num, energy_barr, output_en);
       }
 
-      // time?
-      if (args_info.verbose_lvl_arg>0) {
-        fprintf(stderr, "Findpath(%d/%d): %.2f secs.\n", findpath, num*(num-1)/2, (clock() - clck1)/(double)CLOCKS_PER_SEC);
-        clck1 = clock();
+      // sparse binary rates
+      if (args_info.rates_bin_given) {
+        print_rates_bin(args_info.rates_bin_arg, args_info.temp_arg, num, energy_barr, output_en);
       }
 
-      // create rates for treekin
-      if (args_info.rates_flag) {
-        print_rates(args_info.rates_file_arg, args_info.temp_arg, num, energy_barr, output_en);
+      // master equation on sparse rates
+      if (args_info.kinetics_given) {
+        RateCSR rates;
+        rates.Build(num, energy_barr, output_en, 0.00198717*(273.15 + args_info.temp_arg));
+        vector<double> p0;
+        if (kinetics_p0(num, args_info.kin_p0_given, args_info.kin_p0_arg, p0)) {
+          kinetics(args_info.kinetics_arg, rates, p0, args_info.kin_t0_arg, args_info.kin_t8_arg, args_info.kin_tinc_arg, args_info.verbose_lvl_arg);
+        }
       }
 
       // saddles for evaluation
@@ -504,10 +624,12 @@ int main(int argc, char **argv)
         //PS_tree_plot(nodes, num, "tst.ps");
 
         // make tree (fill missing nodes)
-        make_tree(num, energy_barr, findpath_barr, nodes);
+        lm_tree(num, energy_barr, findpath_barr, output_en, nodes);
 
         // plot it!
         PS_tree_plot(nodes, num, args_info.barr_name_arg);
+        if (args_info.tree_newick_given) newick_tree(nodes, num, args_info.tree_newick_arg);
+        if (args_info.tree_json_given) json_tree(nodes, num, args_info.tree_json_arg);
       }
 
       // time?
@@ -517,6 +639,7 @@ int main(int argc, char **argv)
       }
 
       // ############### actual output
+      if (Stats.on) Stats.Phase(ST_OUTPUT);
       // printf output with fathers! maybe
       printf("     %s\n", seq);
       for (unsigned int i=0; i<output_str.size(); i++) {
@@ -533,6 +656,7 @@ int main(int argc, char **argv)
     } else {
 
       // printf output without fathers!
+      if (Stats.on) Stats.Phase(ST_OUTPUT);
       printf("     %s\n", seq);
       for (unsigned int i=0; i<output_str.size(); i++) {
         if (args_info.eRange_given) {
@@ -549,8 +673,8 @@ int main(int argc, char **argv)
     for(unsigned int i=0; i<output_he.size(); i++) {
       free(output_he[i].structure);
     }
-    // free hash
-    free_hash(structs);
+    // free hash (walked structures go with the sampler)
+    free_hash(merged_structs);
 
     // release res:
     if (energy_barr!=NULL) free(energy_barr);
@@ -574,6 +698,12 @@ int main(int argc, char **argv)
     }
   }
 
+  // run statistics
+  if (Stats.on) {
+    Stats.Phase(ST_NUM);
+    Stats.WriteJson(args_info.stats_json_arg);
+  }
+
   // release resources
   if (seq!=NULL) free(seq);
   if (name!=NULL) free(name);
@@ -697,7 +827,9 @@ char *read_barr(char *barr_arg, map<struct_en, barr_info, comps_entries> &output
     fclose(fbarr);
     exit(EXIT_FAILURE);
   }
-  // read previously found minima:
+  // read previously found minima (all of them first):
+  vector<struct_en> entries;
+  vector<barr_info> infos;
   while ((line = my_getline(fbarr))) {
     p = strtok(line, " \t\n");
 
@@ -707,7 +839,7 @@ char *read_barr(char *barr_arg, map<struct_en, barr_info, comps_entries> &output
 
     // read the stuff
     int num;
-    sscanf(p, "%d", &num);
+    if (p) sscanf(p, "%d", &num);
     p = strtok(NULL, " \t\n");
     if (p && isStruct(p)) {
       he.structure = make_pair_table_PK(p);
@@ -735,20 +867,52 @@ char *read_barr(char *barr_arg, map<struct_en, barr_info, comps_entries> &output
         case 7: sscanf(p, "%f", &bi.feng); break;
       }
     }
+    free(line);
 
-    // try to move it:
-    SeqInfo sqi;
-    sqi.Init(seq);
-    he.energy = Opt.pknots ? energy_of_struct_pk(seq, he.structure, sqi.s0, sqi.s1, 0): energy_of_structure_pt(seq, he.structure, sqi.s0, sqi.s1, 0);
-    int last_en = he.energy;
-    move_set(he, sqi);
-    /*
-    //fprintf(stderr, "%f\n", he.energy);
+    if (he.structure == NULL) continue;
+    entries.push_back(he);
+    infos.push_back(bi);
+  }
 
-    while ((Opt.rand? move_rand(he) : move_set(he))!=0) {
-      Deg.Clear();
+  // try to move them: each structure once (in parallel), with one sequence context
+  int num = entries.size();
+  vector<int> uniq_of(num);       // entry -> its unique structure
+  vector<struct_en> uniq;         // unique structures (from entries) -> their minima
+  vector<int> uniq_en;            // energies of unique structures
+  unordered_map<struct_en, int, hash_fncts, hash_eq> index;
+  for (int i=0; i<num; i++) {
+    unordered_map<struct_en, int, hash_fncts, hash_eq>::iterator it = index.find(entries[i]);
+    if (it != index.end()) {
+      uniq_of[i] = it->second;
+    } else {
+      uniq_of[i] = uniq.size();
+      index[entries[i]] = uniq.size();
+      uniq.push_back(entries[i]);
+      uniq.back().structure = allocopy(entries[i].structure);
     }
-    Deg.Clear();*/
+  }
+  index.clear();
+
+  LMContext ctx(seq, Opt.Walk());
+  if (Stats.on) ctx.stats = &Stats;
+  int num_u = uniq.size();
+  uniq_en.resize(num_u);
+  // energy parameters of pknots are set up lazily - do it before the threads start
+  if (Opt.pknots && num_u>0) lm_energy(ctx, uniq[0].structure);
+  // Neighborhood keeps its state in statics
+  #pragma omp parallel for schedule(dynamic, 16) if (!Opt.neighs)
+  for (int i=0; i<num_u; i++) {
+    uniq[i].energy = uniq_en[i] = lm_energy(ctx, uniq[i].structure);
+    lm_descend(ctx, uniq[i]);
+  }
+
+  // merge them in order of the file
+  for (int i=0; i<num; i++) {
+    struct_en he = uniq[uniq_of[i]];
+    he.structure = entries[i].structure;
+    copy_arr(he.structure, uniq[uniq_of[i]].structure);
+    int last_en = uniq_en[uniq_of[i]];
+    barr_info &bi = infos[i];
 
     // print changes:
     if (last_en != he.energy) {
@@ -764,9 +928,8 @@ char *read_barr(char *barr_arg, map<struct_en, barr_info, comps_entries> &output
     } else {
       output[he] = bi;
     }
-
-    free(line);
   }
+  for (int i=0; i<num_u; i++) free(uniq[i].structure);
 
   fclose(fbarr);
   return seq;
@@ -784,6 +947,7 @@ char *read_seq(char *seq_arg, char **name_out)
     fprintf(stderr, "WARNING: Cannot open file \"%s\".\n", seq_arg);
     // try to read it from 1st line of input:
     seq = my_getline(stdin);
+    input_lines++;
     int j = 0;
     for (unsigned int i=0; i<strlen(seq); i++) {
       if (seq[i]=='A' || seq[i]=='C' || seq[i]=='T' || seq[i]=='G' || seq[i]=='a' || seq[i]=='c' || seq[i]=='t' || seq[i]=='g' || seq[i]=='U' || seq[i]=='u') seq[j++] = seq[i];
@@ -833,11 +997,144 @@ char *read_seq(char *seq_arg, char **name_out)
 }
 
 
-int move(unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> &structs, map<struct_en, int, comps_entries> &output, set<struct_en, comps_entries> &output_shallow, SeqInfo &sqi, bool pure_output)
+// file name for a sequence in batch mode: %s in pattern is replaced by name
+string batch_name(const char *pattern, const string &name)
+{
+  string res(pattern);
+  size_t pos = res.find("%s");
+  if (pos != string::npos) res.replace(pos, 2, name);
+  return res;
+}
+
+// prefix the file name (not the directory) in an argument with sequence name
+void batch_prefix(char *&arg, const string &name)
+{
+  if (arg == NULL) return;
+  string file(arg);
+  size_t pos = file.rfind('/');
+  pos = (pos == string::npos ? 0 : pos+1);
+  file.insert(pos, name + "_");
+  free(arg);
+  arg = strdup(file.c_str());
+}
+
+// batch mode (--batch): sequences from a multi-FASTA file are processed one per worker process,
+//  workers are forked after the energy parameters are loaded, so they share them, at most --batch-jobs run at once
+// returns -1 in a worker (seq and name are set, stdin/stdout redirected to the files of the sequence), exit status in the parent
+int batch_run(gengetopt_args_info &args_info, char **seq_out, char **name_out)
+{
+  FILE *fseq = fopen(args_info.batch_arg, "r");
+  if (fseq == NULL) {
+    fprintf(stderr, "ERROR: Cannot open file \"%s\".\n", args_info.batch_arg);
+    return EXIT_FAILURE;
+  }
+
+  // read all sequences
+  vector<string> names;
+  vector<string> seqs;
+  char *line;
+  while ((line = my_getline(fseq)) != NULL) {
+    if (line[0] == '>') {
+      // name is the first word of the header
+      string name(line+1);
+      name = name.substr(0, name.find_first_of(" \t"));
+      for (unsigned int i=0; i<name.size(); i++) if (name[i]=='/') name[i]='_';
+      names.push_back(name);
+      seqs.push_back("");
+    } else if (isSeq(line)) {
+      if (seqs.empty()) {
+        names.push_back("");
+        seqs.push_back("");
+      }
+      for (int i=0; line[i]!='\0' && line[i]!=' '; i++) {
+        seqs.back() += (line[i]=='T' ? 'U' : line[i]);
+      }
+    }
+    free(line);
+  }
+  fclose(fseq);
+
+  if (seqs.empty()) {
+    fprintf(stderr, "ERROR: No sequence found in \"%s\".\n", args_info.batch_arg);
+    return EXIT_FAILURE;
+  }
+
+  // load energy parameters once (workers get a copy)
+  {
+    string open(seqs[0].size(), '.');
+    energy_of_structure(seqs[0].c_str(), open.c_str(), 0);
+    if (Opt.pknots) energy_of_struct_pk(seqs[0].c_str(), (char*)open.c_str());
+  }
+
+  int running = 0;
+  int failed = 0;
+  for (unsigned int i=0; i<=seqs.size(); i++) {
+    // wait for a free slot (or for all at the end)
+    while (running > 0 && (running >= args_info.batch_jobs_arg || i == seqs.size())) {
+      int status;
+      if (wait(&status) == -1) break;
+      running--;
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+    }
+    if (i == seqs.size()) break;
+
+    char num[20];
+    sprintf(num, "seq%d", i+1);
+    string name = (names[i].empty() ? string(num) : names[i]);
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == -1) {
+      fprintf(stderr, "ERROR: Cannot start worker for sequence \"%s\".\n", name.c_str());
+      failed++;
+      continue;
+    }
+    if (pid > 0) {
+      running++;
+      if (Opt.verbose_lvl>0) fprintf(stderr, "batch: %s (%d/%d)\n", name.c_str(), i+1, (int)seqs.size());
+      continue;
+    }
+
+    // worker:
+    string input = batch_name(args_info.batch_input_arg, name);
+    string output = batch_name(args_info.batch_output_arg, name);
+    if (!args_info.just_read_flag && freopen(input.c_str(), "r", stdin) == NULL) {
+      fprintf(stderr, "ERROR: Cannot open file \"%s\".\n", input.c_str());
+      exit(EXIT_FAILURE);
+    }
+    if (freopen(output.c_str(), "w", stdout) == NULL) {
+      fprintf(stderr, "ERROR: Cannot open file \"%s\".\n", output.c_str());
+      exit(EXIT_FAILURE);
+    }
+    batch_prefix(args_info.barr_name_arg, name);
+    batch_prefix(args_info.tree_newick_arg, name);
+    batch_prefix(args_info.tree_json_arg, name);
+    batch_prefix(args_info.barrier_file_arg, name);
+    batch_prefix(args_info.rates_file_arg, name);
+    batch_prefix(args_info.rates_bin_arg, name);
+    batch_prefix(args_info.kinetics_arg, name);
+    batch_prefix(args_info.allegiance_arg, name);
+    batch_prefix(args_info.shard_out_arg, name);
+    batch_prefix(args_info.stats_json_arg, name);
+
+    *seq_out = strdup(seqs[i].c_str());
+    *name_out = strdup(name.c_str());
+    return -1;
+  }
+
+  if (failed) fprintf(stderr, "ERROR: %d of %d sequences failed.\n", failed, (int)seqs.size());
+  return (failed ? EXIT_FAILURE : 0);
+}
+
+// read one structure from stdin into str, returns -1 at the end of input, 0 if the line has no usable structure,
+//  1 if the energy has to be computed yet, 2 if it is taken from input (--trust-energy)
+int read_structure(SeqInfo &sqi, struct_en &str)
 {
   // read a line
   char *line = my_getline(stdin);
   if (line == NULL) return -1;
+  input_lines++;
   if (line[0]=='>') {
     free(line);
     return 0;
@@ -892,116 +1189,108 @@ int move(unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> &structs, map<
   }
 
   // make make_pair
-  struct_en str;
   str.structure = Opt.pknots? make_pair_table_PK(p):make_pair_table(p);
+  str.energy = 0;
+  free(line);
 
   // only H,K,L,M types allowed:
-  if (!str.structure) {
-    free(line);
-    return 0;
-  } else {
-    str.energy = Opt.pknots? energy_of_struct_pk(sqi.seq, str.structure, sqi.s0, sqi.s1, Opt.verbose_lvl>3):energy_of_structure_pt(sqi.seq, str.structure, sqi.s0, sqi.s1, 0);
-    free(line);
-  }
-
-  // if pure, just do descend and print it:
-  if (pure_output) {
-    //is it canonical (noLP)
-    if (Opt.noLP && find_lone_pair(str.structure)!=-1) {
-      if (Opt.verbose_lvl>0) fprintf(stderr, "WARNING: structure \"%s\" has lone pairs, skipping...\n", pt_to_str_pk(str.structure).c_str());
-      free(str.structure);
-      return -2;
+  if (!str.structure) return 0;
+
+  // energy from input
+  if (Opt.trust_en && energy_found) {
+    str.energy = en_fltoi(energy);
+
+    // check on the first structure, if the energy parameters match
+    static bool checked = false;
+    if (!checked) {
+      checked = true;
+      int en = Opt.pknots? energy_of_struct_pk(sqi.seq, str.structure, sqi.s0, sqi.s1, 0):energy_of_structure_pt(sqi.seq, str.structure, sqi.s0, sqi.s1, 0);
+      if (en != str.energy) {
+        fprintf(stderr, "WARNING: energy in input (%.2f) differs from computed energy (%.2f), switching --trust-energy off\n", str.energy/100.0, en/100.0);
+        Opt.trust_en = false;
+        str.energy = en;
+      }
     }
+    return 2;
+  }
+  return 1;
+}
 
-    //debugging
-    if (Opt.verbose_lvl>1) fprintf(stderr, "proc(pure): %d %s\n", num_moves, pt_to_str_pk(str.structure).c_str());
+// read one structure from input and walk it: into sampler or (pure_output) just print its minimum
+//  returns as LMSampler::Add() (-1 at the end of input)
+int move(LMSampler &sampler, LMContext &ctx, bool pure_output)
+{
+  struct_en str;
+  int res = read_structure(ctx.sqi, str);
+  if (res <= 0) return res;
+  if (res == 1) str.energy = lm_energy(ctx, str.structure);
 
-    // descend
-    int gw_length = move_set(str, sqi);
-    // only some types of PK allowed!!!
-    if (Opt.pknots && str.energy == INT_MAX) {
-      free(str.structure);
-      return 0;
-    }
+  if (!pure_output) return sampler.Add(ctx, str);
 
-    if (Opt.verbose_lvl>2) fprintf(stderr, "\n  %s %d %d\n", pt_to_str_pk(str.structure).c_str(), str.energy, gw_length);
-    printf("%s %6.2f %4d\n", pt_to_str_pk(str.structure).c_str(), str.energy/100.0, gw_length);
+  // if pure, just do descend and print it:
+  //is it canonical (noLP)
+  if (Opt.noLP && find_lone_pair(str.structure)!=-1) {
+    if (Opt.verbose_lvl>0) fprintf(stderr, "WARNING: structure \"%s\" has lone pairs, skipping...\n", pt_to_str_pk(str.structure).c_str());
     free(str.structure);
-    return 1;
+    return -2;
   }
 
-  // check if it was before
-  unordered_map<struct_en, gw_struct, hash_fncts, hash_eq>::iterator it_s = structs.find(str);
+  //debugging
+  if (Opt.verbose_lvl>1) fprintf(stderr, "proc(pure): %d %s\n", num_moves, pt_to_str_pk(str.structure).c_str());
 
-  // if it was - release memory + get another
-  if (it_s != structs.end()) {
-    it_s->second.count++;
+  // descend (last column is the length of the walk with -N, energy of the minimum otherwise)
+  int gw_length = INT_MAX;
+  lm_descend(ctx, str, &gw_length);
+  if (!Opt.neighs) gw_length = str.energy;
+  // only some types of PK allowed!!!
+  if (Opt.pknots && str.energy == INT_MAX) {
     free(str.structure);
     return 0;
-  } else {
-    // find energy only if not in input (not working - does energy_of_move require energy_of_struct run first???)
-    //str.energy = Enc.Energy(str);
-    //printf("\n%s\n%s %7.2f\n\n", Enc.seq, pt_to_str_pk(str.structure).c_str(), str.energy/100.0);
-    /*if (1 || !energy_found) str.energy = Enc.Energy(str);
-    else str.energy = (int)(energy*100.0+(energy<0.0 ? -0.5 : 0.5));*/
-
-    // allegiance hack:
-    struct_en he_str = str;
-    if (allegiance) {
-      structures.push_back(he_str);
-    }
-
-    //is it canonical (noLP)
-    if (Opt.noLP && find_lone_pair(str.structure)!=-1) {
-      if (Opt.verbose_lvl>0) fprintf(stderr, "WARNING: structure \"%s\" has lone pairs, skipping...\n", pt_to_str_pk(str.structure).c_str());
-      free(str.structure);
-      return -2;
-    }
+  }
 
-    // copy it anew
-    struct_en old = str;
-    str.structure = allocopy(str.structure);
+  if (Opt.verbose_lvl>2) fprintf(stderr, "\n  %s %d %d\n", pt_to_str_pk(str.structure).c_str(), str.energy, gw_length);
+  printf("%s %6.2f %4d\n", pt_to_str_pk(str.structure).c_str(), str.energy/100.0, gw_length);
+  free(str.structure);
+  return 1;
+}
 
-    //debugging
-    if (Opt.verbose_lvl>1) fprintf(stderr, "processing: %d %s\n", num_moves, pt_to_str_pk(str.structure).c_str());
+// two-phase processing: read the whole input first (only unique structures are kept with counts),
+// then walk the unique structures in parallel and fold the results into sampler in order of appearance
+// returns number of structures with lone pairs (skipped)
+int move_batch(LMSampler &sampler, LMContext &ctx)
+{
+  clock_t clck1 = clock();
 
-    // descend
-    move_set(str, sqi);
-    // only some types of PK allowed!!!
-    if (Opt.pknots && str.energy == INT_MAX) {
+  // phase 1: ingest (structures are stored once, energy is computed only for unique ones in phase 2)
+  vector<struct_en> uniq;
+  vector<int> counts;
+  unordered_map<struct_en, int, hash_fncts, hash_eq> index;
+  struct_en str;
+  int res;
+  while ((res = read_structure(ctx.sqi, str)) != -1) {
+    if (res == 0) continue;
+    unordered_map<struct_en, int, hash_fncts, hash_eq>::iterator it = index.find(str);
+    if (it != index.end()) {
+      counts[it->second]++;
       free(str.structure);
-      free(old.structure);
-      return 0;
+    } else {
+      index[str] = uniq.size();
+      uniq.push_back(str);
+      counts.push_back(1);
+      // energy not taken from input - computed in phase 2
+      if (res == 1) uniq.back().energy = INT_MAX;
     }
+    if (Opt.verbose_lvl>0 && num_moves%(Opt.pknots?1000:10000)==0) fprintf(stderr, "read %d, unique %d, time %f secs.\n", num_moves, (int)uniq.size(), (clock()-clck1)/(double)CLOCKS_PER_SEC);
+  }
+  index.clear();
 
-    // insert into hash (memory is here only on left side)
-    gw_struct &lm = structs[old];
-    lm.count = 1;
-    /*
-    int i;
-    while ((i = (Opt.rand? move_rand(str) : move_set(str)))!=0) {
-      Deg.Clear();
-    }
-    Deg.Clear();*/
+  int num = uniq.size();
+  if (Opt.verbose_lvl>0) fprintf(stderr, "read %d structures, %d unique\n", num_moves, num);
 
-    if (Opt.verbose_lvl>2) fprintf(stderr, "\n  %s %d\n", pt_to_str_pk(str.structure).c_str(), str.energy);
+  // phase 2: walk (in parallel) and fold into hash and output
+  int not_canonical = sampler.AddAll(ctx, uniq, counts);
 
-    // save for output
-    map<struct_en, int, comps_entries>::iterator it;
-    if ((it = output.find(str)) != output.end()) {
-      it->second++;
-      lm.he = it->first;
-      free(str.structure);
-      // allegiance hack:
-      if (allegiance) str_to_LM[he_str] = it->first;
-    } else {
-      //str.num = output.size();
-      lm.he = str;
-      output.insert(make_pair(str, 1));
-      // allegiance hack:
-      if (allegiance) str_to_LM[he_str] = str;
-    }
-  }
+  if (Opt.verbose_lvl>0) fprintf(stderr, "walked %d unique structures, time %f secs.\n", num, (clock()-clck1)/(double)CLOCKS_PER_SEC);
 
-  return 1;
+  return not_canonical;
 }
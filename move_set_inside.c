@@ -11,6 +11,8 @@
 #include "utils.h"
 
 #include "move_set.h"
+#include "profile.h"
+#include "pair_info.h"
 
 /* maximum degeneracy value - if degeneracy is greater than this, program segfaults */
 #define MAX_DEGEN 100
@@ -41,6 +43,8 @@ typedef struct _Encoded {
   short *s1;
 
   const char  *seq;
+  const pair_info *pairs;   /* pairing tables of seq */
+  uint64_t *paired;         /* scratch mask of paired positions (pairs->words), allocated once per walk */
 
   /* moves*/
   int   bp_left;
@@ -71,6 +75,8 @@ typedef struct _Encoded {
   /* function for flooding */
   int (*funct) (struct_en*, struct_en*);
 
+  /* walk kernel specialized for the options above (see select_kernel) */
+  int (*kernel) (struct _Encoded*, struct_en*);
 
 } Encoded;
 
@@ -86,16 +92,19 @@ PRIVATE int     lone_base(short *pt, int i, int j);
 PRIVATE int     exists_base(short *pt, int i, int j);
 PRIVATE void    free_degen(Encoded *Enc);
 PRIVATE inline void do_move(short *pt, int bp_left, int bp_right);
-PRIVATE int     update_deepest(Encoded *Enc, struct_en *str, struct_en *min);
-PRIVATE int     deletions(Encoded *Enc, struct_en *str, struct_en *minim);
-PRIVATE inline  bool compat(char a, char b);
-PRIVATE inline  bool try_insert(const short *pt, const char *seq, int i, int j);
-PRIVATE inline  bool try_insert_seq(const char *seq, int i, int j);
-PRIVATE int     insertions(Encoded *Enc, struct_en *str, struct_en *minim);
-PRIVATE int     shifts(Encoded *Enc, struct_en *str, struct_en *minim);
-PRIVATE int     move_set(Encoded *Enc, struct_en *str);
+PRIVATE inline  bool try_insert(const short *pt, const pair_info *pairs, int i, int j);
+PRIVATE inline  bool try_insert_seq(const pair_info *pairs, int i, int j);
 PRIVATE void    construct_moves(Encoded *Enc, short *structure);
-PRIVATE int     move_rset(Encoded *Enc, struct_en *str);
+PRIVATE void    select_kernel(Encoded *Enc, int random);
+
+/* number of moves of the last walk in this thread */
+PRIVATE int last_steps = 0;
+#pragma omp threadprivate(last_steps)
+
+/* the walk functions below are kernels - they take the options (first, shift, noLP, use of funct, verbosity)
+   as constant arguments and are always inlined into the specializations at the end of the file,
+   so the per-move checks of the options are resolved at compile time */
+#define KERNEL static inline __attribute__((always_inline))
 
 
 /*
@@ -199,14 +208,16 @@ do_move(short *pt, int bp_left, int bp_right){
 }
 
 /* done with all structures along the way to deepest*/
-PRIVATE int
-update_deepest(Encoded *Enc, struct_en *str, struct_en *min){
+KERNEL int
+update_deepest(Encoded *Enc, struct_en *str, struct_en *min, const int use_funct, const int verbose){
 
   /* apply move + get its energy*/
   int tmp_en;
+  PROF_COUNT(PROF_MOVE);
   tmp_en = str->energy + energy_of_move_pt(str->structure, Enc->s0, Enc->s1, Enc->bp_left, Enc->bp_right);
   do_move(str->structure, Enc->bp_left, Enc->bp_right);
   if (Enc->bp_left2 != 0) {
+    PROF_COUNT(PROF_MOVE);
     tmp_en += energy_of_move_pt(str->structure, Enc->s0, Enc->s1, Enc->bp_left2, Enc->bp_right2);
     do_move(str->structure, Enc->bp_left2, Enc->bp_right2);
   }
@@ -214,7 +225,7 @@ update_deepest(Encoded *Enc, struct_en *str, struct_en *min){
   str->energy = tmp_en;
 
   /* use f_point if we have it */
-  if (Enc->funct) {
+  if (use_funct) {
     int end = Enc->funct(str, min);
 
     /* undo moves */
@@ -229,7 +240,7 @@ update_deepest(Encoded *Enc, struct_en *str, struct_en *min){
     return (end?1:0);
   }
 
-  if (Enc->verbose_lvl>1) { fprintf(stderr, "  "); print_str(stderr, str->structure); fprintf(stderr, " %5d D\n", tmp_en); }
+  if (verbose && Enc->verbose_lvl>1) { fprintf(stderr, "  "); print_str(stderr, str->structure); fprintf(stderr, " %5d D\n", tmp_en); }
 
   /* better deepest*/
   if (str->energy < min->energy || (!deal_deg && str->energy == min->energy && compare(str->structure, min->structure))) {
@@ -286,15 +297,15 @@ update_deepest(Encoded *Enc, struct_en *str, struct_en *min){
 
 
 /* deletions move set*/
-PRIVATE int
-deletions(Encoded *Enc, struct_en *str, struct_en *minim){
+KERNEL int
+deletions(Encoded *Enc, struct_en *str, struct_en *minim, const int first, const int noLP, const int use_funct, const int verbose){
 
   int cnt = 0;
   short *pt = str->structure;
   int len = pt[0];
   int i;
 
-  if (Enc->verbose_lvl>1) { fprintf(stderr, "  "); print_str(stderr, str->structure); fprintf(stderr, " %5d Deletions:\n", str->energy); }
+  if (verbose && Enc->verbose_lvl>1) { fprintf(stderr, "  "); print_str(stderr, str->structure); fprintf(stderr, " %5d Deletions:\n", str->energy); }
 
   for (i=1; i<=len; i++) {
     if (pt[i]>pt[pt[i]]) {  /* '('*/
@@ -302,7 +313,7 @@ deletions(Encoded *Enc, struct_en *str, struct_en *minim){
       Enc->bp_right=-pt[i];
 
       /*if nolp enabled, make (maybe) 2nd delete*/
-      if (Enc->noLP) {
+      if (noLP) {
         /* is there a pair around? */
         bool inside_pair = exists_base(pt, i+1, pt[i]-1);
         bool outside_pair = exists_base(pt, i-1, pt[i]+1);
@@ -328,61 +339,47 @@ deletions(Encoded *Enc, struct_en *str, struct_en *minim){
         }
       }
       /* finally the delete */
-      cnt += update_deepest(Enc, str, minim);
+      cnt += update_deepest(Enc, str, minim, use_funct, verbose);
       /* in case useFirst is on and structure is found, end*/
-      if (Enc->first && cnt > 0) return cnt;
+      if (first && cnt > 0) return cnt;
     }
   }
   return cnt;
 }
 
-  /* compatible base pair?*/
-PRIVATE inline bool
-compat(char a, char b){
-
-  if (a=='A' && b=='U') return true;
-  if (a=='C' && b=='G') return true;
-  if (a=='G' && b=='U') return true;
-  if (a=='U' && b=='A') return true;
-  if (a=='G' && b=='C') return true;
-  if (a=='U' && b=='G') return true;
-  /* and with T's*/
-  if (a=='A' && b=='T') return true;
-  if (a=='T' && b=='A') return true;
-  if (a=='G' && b=='T') return true;
-  if (a=='T' && b=='G') return true;
-  return false;
-}
-
 /* try insert base pair (i,j) */
 PRIVATE inline bool
-try_insert(const short *pt, const char *seq, int i, int j){
+try_insert(const short *pt, const pair_info *pairs, int i, int j){
 
   if (i<=0 || j<=0 || i>pt[0] || j>pt[0]) return false;
-  return (j-i>MINGAP && pt[j]==0 && pt[i]==0 && compat(seq[i-1], seq[j-1]));
+  return (j-i>MINGAP && pt[j]==0 && pt[i]==0 && pair_ok(pairs, i, j));
 }
 
 /* try insert base pair (i,j) */
 PRIVATE inline bool
-try_insert_seq(const char *seq, int i, int j){
+try_insert_seq(const pair_info *pairs, int i, int j){
   if (i<=0 || j<=0) return false;
-  return (j-i>MINGAP && compat(seq[i-1], seq[j-1]));
+  return (j-i>MINGAP && pair_ok(pairs, i, j));
 }
 
 /* insertions move set */
-PRIVATE int
-insertions(Encoded *Enc, struct_en *str, struct_en *minim){
+KERNEL int
+insertions(Encoded *Enc, struct_en *str, struct_en *minim, const int first, const int noLP, const int use_funct, const int verbose){
 
   int cnt = 0;
   short *pt = str->structure;
   int len = pt[0];
   int i,j;
 
-  if (Enc->verbose_lvl>1) { fprintf(stderr, "  "); print_str(stderr, str->structure); fprintf(stderr, " %5d Insertions:\n", str->energy); }
+  if (verbose && Enc->verbose_lvl>1) { fprintf(stderr, "  "); print_str(stderr, str->structure); fprintf(stderr, " %5d Insertions:\n", str->energy); }
+
+  /* visit only paired positions (brackets) and partners of i*/
+  uint64_t *paired = Enc->paired;
+  pair_mask(Enc->pairs, pt, paired);
 
   for (i=1; i<=len; i++) {
     if (pt[i]==0) {
-      for (j=i+1; j<=len; j++) {
+      for (j=pair_next(Enc->pairs, paired, i, i+1, len); j; j=pair_next(Enc->pairs, paired, i, j+1, len)) {
         /* end if found closing bracket*/
         if (pt[j]!=0 && pt[j]<j) break;  /*')'*/
         if (pt[j]!=0 && pt[j]>j) {       /*'('*/
@@ -390,15 +387,15 @@ insertions(Encoded *Enc, struct_en *str, struct_en *minim){
           continue;
         }
         /* if conditions are met, do insert*/
-        if (try_insert(pt, Enc->seq, i, j)) {
+        if (try_insert(pt, Enc->pairs, i, j)) {
           Enc->bp_left=i;
           Enc->bp_right=j;
 
-          if (Enc->noLP) {
+          if (noLP) {
             /* if lone bases occur, try inserting one another base*/
             if (lone_base(pt, i, j)) {
               /* try only inside insert -- not to repeat structures*/
-              if (try_insert(pt, Enc->seq, i+1, j-1)) {
+              if (try_insert(pt, Enc->pairs, i+1, j-1)) {
                 /* but now, check if this second insert does not extend the stem */
                 if (pt[i+2] != 0 && pt[i+2] == pt[j-2]) continue;
 
@@ -409,9 +406,9 @@ insertions(Encoded *Enc, struct_en *str, struct_en *minim){
           }
 
           /* finally insert: */
-          cnt += update_deepest(Enc, str, minim);
+          cnt += update_deepest(Enc, str, minim, use_funct, verbose);
           /* in case useFirst is on and structure is found, end*/
-          if (Enc->first && cnt > 0) return cnt;
+          if (first && cnt > 0) return cnt;
         }
       }
     }
@@ -420,8 +417,8 @@ insertions(Encoded *Enc, struct_en *str, struct_en *minim){
 }
 
 /*shift move set*/
-PRIVATE int
-shifts(Encoded *Enc, struct_en *str, struct_en *minim){
+KERNEL int
+shifts(Encoded *Enc, struct_en *str, struct_en *minim, const int first, const int use_funct, const int verbose){
 
   int cnt = 0;
   int brack_num = 0;
@@ -434,7 +431,7 @@ shifts(Encoded *Enc, struct_en *str, struct_en *minim){
       int j=pt[i];
 
       /* outer switch left*/
-      if (Enc->verbose_lvl>1) fprintf(stderr, "%2d bracket %2d position, outer switch left\n", brack_num+1, i);
+      if (verbose && Enc->verbose_lvl>1) fprintf(stderr, "%2d bracket %2d position, outer switch left\n", brack_num+1, i);
       for (k=i-1; k>0; k--) {
         if (pt[k]!=0 && pt[k]>k/*'('*/) break;
         if (pt[k]!=0 && pt[k]<k/*')'*/) {
@@ -447,31 +444,31 @@ shifts(Encoded *Enc, struct_en *str, struct_en *minim){
         }
 
         /* switch (i,j) to (k,j)*/
-        if (j-k>MINGAP && compat(Enc->seq[k-1], Enc->seq[j-1])) {
+        if (pair_ok(Enc->pairs, k, j)) {
           Enc->bp_left=-i;
           Enc->bp_right=-j;
           Enc->bp_left2=k;
           Enc->bp_right2=j;
-          cnt += update_deepest(Enc, str, minim);
+          cnt += update_deepest(Enc, str, minim, use_funct, verbose);
           /* in case useFirst is on and structure is found, end*/
-          if (Enc->first && cnt > 0) return cnt;
+          if (first && cnt > 0) return cnt;
         }
 
         /* switch (i,j) to (k,i)*/
-        if (i-k>MINGAP && compat(Enc->seq[i-1], Enc->seq[k-1])) {
+        if (pair_ok(Enc->pairs, k, i)) {
           Enc->bp_left=-i;
           Enc->bp_right=-j;
           Enc->bp_left2=k;
           Enc->bp_right2=i;
-          cnt += update_deepest(Enc, str, minim);
+          cnt += update_deepest(Enc, str, minim, use_funct, verbose);
           /* in case useFirst is on and structure is found, end*/
-          if (Enc->first && cnt > 0) return cnt;
+          if (first && cnt > 0) return cnt;
 
         }
       }
 
       /* outer switch right*/
-      if (Enc->verbose_lvl>1) fprintf(stderr, "%2d bracket %2d position, outer switch right\n", brack_num+1, i);
+      if (verbose && Enc->verbose_lvl>1) fprintf(stderr, "%2d bracket %2d position, outer switch right\n", brack_num+1, i);
       for (k=j+1; k<=len; k++) {
         if (pt[k]!=0 && pt[k]<k/*')'*/) break;
         if (pt[k]!=0 && pt[k]>k/*'('*/) {
@@ -484,28 +481,28 @@ shifts(Encoded *Enc, struct_en *str, struct_en *minim){
           fprintf(stderr, "WARNING: \'%c\'should be \'.\' at pos %d!\n", pt[k], k);
         }
         /* switch (i,j) to (i,k)*/
-        if (k-i>MINGAP && compat(Enc->seq[i-1], Enc->seq[k-1])) {
+        if (pair_ok(Enc->pairs, i, k)) {
           Enc->bp_left=-i;
           Enc->bp_right=-j;
           Enc->bp_left2=i;
           Enc->bp_right2=k;
-          cnt += update_deepest(Enc, str, minim);
+          cnt += update_deepest(Enc, str, minim, use_funct, verbose);
           /* in case useFirst is on and structure is found, end*/
-          if (Enc->first && cnt > 0) return cnt;
+          if (first && cnt > 0) return cnt;
         }
         /* switch (i,j) to (j,k)*/
-        if (k-j>MINGAP && compat(Enc->seq[j-1], Enc->seq[k-1])) {
+        if (pair_ok(Enc->pairs, j, k)) {
           Enc->bp_left=-i;
           Enc->bp_right=-j;
           Enc->bp_left2=j;
           Enc->bp_right2=k;
-          cnt += update_deepest(Enc, str, minim);
+          cnt += update_deepest(Enc, str, minim, use_funct, verbose);
           /* in case useFirst is on and structure is found, end*/
-          if (Enc->first && cnt > 0) return cnt;
+          if (first && cnt > 0) return cnt;
         }
       }
 
-      if (Enc->verbose_lvl>1) fprintf(stderr, "%2d bracket %2d position, inner switch\n", brack_num+1, i);
+      if (verbose && Enc->verbose_lvl>1) fprintf(stderr, "%2d bracket %2d position, inner switch\n", brack_num+1, i);
       /* inner switch*/
       for (k=i+1; k<j; k++) {
         /* jump to end of the sub-bracketing*/
@@ -515,25 +512,25 @@ shifts(Encoded *Enc, struct_en *str, struct_en *minim){
         }
 
         /* left switch (i,j) to (k,j)*/
-        if (j-k>MINGAP && compat(Enc->seq[k-1], Enc->seq[j-1])) {
+        if (pair_ok(Enc->pairs, k, j)) {
           Enc->bp_left=-i;
           Enc->bp_right=-j;
           Enc->bp_left2=k;
           Enc->bp_right2=j;
-          cnt += update_deepest(Enc, str, minim);
+          cnt += update_deepest(Enc, str, minim, use_funct, verbose);
           /* in case useFirst is on and structure is found, end*/
-          if (Enc->first && cnt > 0) return cnt;
+          if (first && cnt > 0) return cnt;
         }
 
         /* right switch (i,j) to (i,k)*/
-        if (k-i>MINGAP && compat(Enc->seq[i-1], Enc->seq[k-1])) {
+        if (pair_ok(Enc->pairs, i, k)) {
           Enc->bp_left=-i;
           Enc->bp_right=-j;
           Enc->bp_left2=i;
           Enc->bp_right2=k;
-          cnt += update_deepest(Enc, str, minim);
+          cnt += update_deepest(Enc, str, minim, use_funct, verbose);
           /* in case useFirst is on and structure is found, end*/
-          if (Enc->first && cnt > 0) return cnt;
+          if (first && cnt > 0) return cnt;
         }
       } /* end inner switch for*/
       brack_num++;
@@ -543,8 +540,8 @@ shifts(Encoded *Enc, struct_en *str, struct_en *minim){
 }
 
 /* move to deepest (or first) neighbour*/
-PRIVATE int
-move_set(Encoded *Enc, struct_en *str){
+KERNEL int
+move_set(Encoded *Enc, struct_en *str, const int first, const int shift, const int noLP, const int use_funct, const int verbose){
 
   /* count better neighbours*/
   int cnt = 0;
@@ -555,23 +552,23 @@ move_set(Encoded *Enc, struct_en *str){
   min.energy = str->energy;
   Enc->current_en = str->energy;
 
-  if (Enc->verbose_lvl>0) { fprintf(stderr, "  start of MS:\n  "); print_str(stderr, str->structure); fprintf(stderr, " %d\n\n", str->energy); }
+  if (verbose && Enc->verbose_lvl>0) { fprintf(stderr, "  start of MS:\n  "); print_str(stderr, str->structure); fprintf(stderr, " %d\n\n", str->energy); }
 
   /* if using first dont do all of them*/
   bool end = false;
   /* insertions*/
-  if (!end) cnt += insertions(Enc, str, &min);
-  if (Enc->first && cnt>0) end = true;
-  if (Enc->verbose_lvl>1) fprintf(stderr, "\n");
+  if (!end) cnt += insertions(Enc, str, &min, first, noLP, use_funct, verbose);
+  if (first && cnt>0) end = true;
+  if (verbose && Enc->verbose_lvl>1) fprintf(stderr, "\n");
 
   /* deletions*/
-  if (!end) cnt += deletions(Enc, str, &min);
-  if (Enc->first && cnt>0) end = true;
+  if (!end) cnt += deletions(Enc, str, &min, first, noLP, use_funct, verbose);
+  if (first && cnt>0) end = true;
 
   /* shifts (only if enabled + noLP disabled)*/
-  if (!end && Enc->shift && !Enc->noLP) {
-    cnt += shifts(Enc, str, &min);
-    if (Enc->first && cnt>0) end = true;
+  if (!end && shift && !noLP) {
+    cnt += shifts(Enc, str, &min, first, use_funct, verbose);
+    if (first && cnt>0) end = true;
   }
 
   /* if degeneracy occurs, solve it!*/
@@ -581,7 +578,7 @@ move_set(Encoded *Enc, struct_en *str){
     str->structure = Enc->unprocessed[Enc->begin_unpr];
     Enc->unprocessed[Enc->begin_unpr]=NULL;
     Enc->begin_unpr++;
-    cnt += move_set(Enc, str);
+    cnt += Enc->kernel(Enc, str);
   } else {
     /* write output to str*/
     copy_arr(str->structure, min.structure);
@@ -604,7 +601,7 @@ move_set(Encoded *Enc, struct_en *str){
     free_degen(Enc);
   }
 
-  if (Enc->verbose_lvl>1 && !(Enc->first)) { fprintf(stderr, "\n  end of MS:\n  "); print_str(stderr, str->structure); fprintf(stderr, " %d\n\n", str->energy); }
+  if (verbose && Enc->verbose_lvl>1 && !first) { fprintf(stderr, "\n  end of MS:\n  "); print_str(stderr, str->structure); fprintf(stderr, " %d\n\n", str->energy); }
 
   return cnt;
 }
@@ -614,6 +611,8 @@ construct_moves(Encoded *Enc, short *structure){
 
   /* generate all possible moves (less than n^2)*/
   Enc->num_moves = 0;
+  uint64_t *paired = Enc->paired;
+  pair_mask(Enc->pairs, structure, paired);
   int i;
   for (i=1; i<=structure[0]; i++) {
     if (structure[i]!=0) {
@@ -623,9 +622,9 @@ construct_moves(Encoded *Enc, short *structure){
       Enc->num_moves++;
     } else {
       int j;
-      for (j=i+1; j<=structure[0]; j++) {
+      for (j=pair_next(Enc->pairs, paired, i, i+1, structure[0]); j; j=pair_next(Enc->pairs, paired, i, j+1, structure[0])) {
         if (structure[j]==0) {
-          if (try_insert_seq(Enc->seq,i,j)) {
+          if (try_insert_seq(Enc->pairs,i,j)) {
             Enc->moves_from[Enc->num_moves]=i;
             Enc->moves_to[Enc->num_moves]=j;
             Enc->num_moves++;
@@ -652,8 +651,8 @@ construct_moves(Encoded *Enc, short *structure){
   }
 }
 
-PRIVATE int
-move_rset(Encoded *Enc, struct_en *str){
+KERNEL int
+move_rset(Encoded *Enc, struct_en *str, const int verbose){
 
   /* count better neighbours*/
   int cnt = 0;
@@ -664,7 +663,7 @@ move_rset(Encoded *Enc, struct_en *str){
   min.energy = str->energy;
   Enc->current_en = str->energy;
 
-  if (Enc->verbose_lvl>0) { fprintf(stderr, "  start of MR:\n  "); print_str(stderr, str->structure); fprintf(stderr, " %d\n\n", str->energy); }
+  if (verbose && Enc->verbose_lvl>0) { fprintf(stderr, "  start of MR:\n  "); print_str(stderr, str->structure); fprintf(stderr, " %d\n\n", str->energy); }
 
   /* construct and permute possible moves */
   construct_moves(Enc, str->structure);
@@ -674,7 +673,7 @@ move_rset(Encoded *Enc, struct_en *str){
   for (i=0; i<Enc->num_moves; i++) {
     Enc->bp_left = Enc->moves_from[i];
     Enc->bp_right = Enc->moves_to[i];
-    cnt = update_deepest(Enc, str, &min);
+    cnt = update_deepest(Enc, str, &min, 0, verbose);
     if (cnt) break;
   }
 
@@ -685,7 +684,7 @@ move_rset(Encoded *Enc, struct_en *str){
     str->structure = Enc->unprocessed[Enc->begin_unpr];
     Enc->unprocessed[Enc->begin_unpr]=NULL;
     Enc->begin_unpr++;
-    cnt += move_rset(Enc, str);
+    cnt += Enc->kernel(Enc, str);
   } else {
     /* write output to str*/
     copy_arr(str->structure, min.structure);
@@ -728,6 +727,51 @@ lone_base(short *pt, int i, int j){
   return !exists_base(pt, i-1, j+1) && !exists_base(pt, i+1, j-1);
 }
 
+/* specializations of the walk kernels (options are compile-time constants in each of them) */
+#define MOVE_SET_KERNEL(first, shift, noLP, use_funct) \
+PRIVATE int move_set_##first##shift##noLP##use_funct(Encoded *Enc, struct_en *str) { return move_set(Enc, str, first, shift, noLP, use_funct, 0); }
+
+MOVE_SET_KERNEL(0, 0, 0, 0)
+MOVE_SET_KERNEL(0, 0, 0, 1)
+MOVE_SET_KERNEL(0, 0, 1, 0)
+MOVE_SET_KERNEL(0, 0, 1, 1)
+MOVE_SET_KERNEL(0, 1, 0, 0)
+MOVE_SET_KERNEL(0, 1, 0, 1)
+MOVE_SET_KERNEL(1, 0, 0, 0)
+MOVE_SET_KERNEL(1, 0, 0, 1)
+MOVE_SET_KERNEL(1, 0, 1, 0)
+MOVE_SET_KERNEL(1, 0, 1, 1)
+MOVE_SET_KERNEL(1, 1, 0, 0)
+MOVE_SET_KERNEL(1, 1, 0, 1)
+
+/* indexed by [first][shift][noLP][use_funct] (shifts are never used with noLP) */
+PRIVATE int (*const move_set_kernels[2][2][2][2]) (Encoded*, struct_en*) = {
+  {{{move_set_0000, move_set_0001}, {move_set_0010, move_set_0011}},
+   {{move_set_0100, move_set_0101}, {move_set_0010, move_set_0011}}},
+  {{{move_set_1000, move_set_1001}, {move_set_1010, move_set_1011}},
+   {{move_set_1100, move_set_1101}, {move_set_1010, move_set_1011}}}
+};
+
+/* verbose walks are rare, they keep the options as runtime values */
+PRIVATE int move_set_verbose(Encoded *Enc, struct_en *str) { return move_set(Enc, str, Enc->first, Enc->shift, Enc->noLP, Enc->funct!=NULL, 1); }
+
+PRIVATE int move_rset_quiet(Encoded *Enc, struct_en *str) { return move_rset(Enc, str, 0); }
+PRIVATE int move_rset_verbose(Encoded *Enc, struct_en *str) { return move_rset(Enc, str, 1); }
+
+/* choose the kernel for the options in Enc (once per walk) */
+PRIVATE void
+select_kernel(Encoded *Enc, int random){
+
+  int verbose = Enc->verbose_lvl>0;
+  if (random) {
+    Enc->kernel = verbose ? move_rset_verbose : move_rset_quiet;
+  } else if (verbose) {
+    Enc->kernel = move_set_verbose;
+  } else {
+    Enc->kernel = move_set_kernels[Enc->first!=0][Enc->shift!=0][Enc->noLP!=0][Enc->funct!=NULL];
+  }
+}
+
 PUBLIC int
 move_standard(char *seq,
               char *struc,
@@ -764,16 +808,26 @@ move_standard(char *seq,
 }
 
 PUBLIC int
-move_gradient(char *string,
+move_last_steps(){
+
+  return last_steps;
+}
+
+PUBLIC int
+move_gradient_en(char *string,
               short *ptable,
               short *s,
               short *s1,
+              const pair_info *pairs,
+              int energy,
               int verbosity_level,
               int shifts,
               int noLP){
 
   Encoded enc;
   enc.seq = string;
+  enc.pairs = pairs;
+  enc.paired = (uint64_t*) space(sizeof(uint64_t)*pairs->words);
   enc.s0 = s;
   enc.s1 = s1;
 
@@ -798,36 +852,59 @@ move_gradient(char *string,
 
   /* function */
   enc.funct=NULL;
+  select_kernel(&enc, 0);
 
   int i;
   for (i=0; i<MAX_DEGEN; i++) enc.processed[i]=enc.unprocessed[i]=NULL;
 
   struct_en str;
   str.structure = allocopy(ptable);
-  str.energy = energy_of_structure_pt(enc.seq, str.structure, enc.s0, enc.s1, 0);
+  str.energy = energy;
 
-  while (move_set(&enc, &str)!=0) {
+  last_steps = 0;
+  while (enc.kernel(&enc, &str)!=0) {
+    last_steps++;
     free_degen(&enc);
   }
   free_degen(&enc);
 
   copy_arr(ptable, str.structure);
   free(str.structure);
+  free(enc.paired);
 
   return str.energy;
 }
 
 PUBLIC int
-move_first( char *string,
+move_gradient(char *string,
+              short *ptable,
+              short *s,
+              short *s1,
+              int verbosity_level,
+              int shifts,
+              int noLP){
+
+  pair_info *pairs = pair_info_new(string);
+  int energy = move_gradient_en(string, ptable, s, s1, pairs, energy_of_structure_pt(string, ptable, s, s1, 0), verbosity_level, shifts, noLP);
+  pair_info_free(pairs);
+  return energy;
+}
+
+PUBLIC int
+move_first_en( char *string,
             short *ptable,
             short *s,
             short *s1,
+            const pair_info *pairs,
+            int energy,
             int verbosity_level,
             int shifts,
             int noLP){
 
   Encoded enc;
   enc.seq = string;
+  enc.pairs = pairs;
+  enc.paired = (uint64_t*) space(sizeof(uint64_t)*pairs->words);
   enc.s0 = s;
   enc.s1 = s1;
 
@@ -852,36 +929,59 @@ move_first( char *string,
 
   /* function */
   enc.funct=NULL;
+  select_kernel(&enc, 0);
 
   int i;
   for (i=0; i<MAX_DEGEN; i++) enc.processed[i]=enc.unprocessed[i]=NULL;
 
   struct_en str;
   str.structure = allocopy(ptable);
-  str.energy = energy_of_structure_pt(enc.seq, str.structure, enc.s0, enc.s1, 0);
+  str.energy = energy;
 
-  while (move_set(&enc, &str)!=0) {
+  last_steps = 0;
+  while (enc.kernel(&enc, &str)!=0) {
+    last_steps++;
     free_degen(&enc);
   }
   free_degen(&enc);
 
   copy_arr(ptable, str.structure);
   free(str.structure);
+  free(enc.paired);
 
   return str.energy;
 }
 
 PUBLIC int
-move_adaptive(char *string,
+move_first( char *string,
+            short *ptable,
+            short *s,
+            short *s1,
+            int verbosity_level,
+            int shifts,
+            int noLP){
+
+  pair_info *pairs = pair_info_new(string);
+  int energy = move_first_en(string, ptable, s, s1, pairs, energy_of_structure_pt(string, ptable, s, s1, 0), verbosity_level, shifts, noLP);
+  pair_info_free(pairs);
+  return energy;
+}
+
+PUBLIC int
+move_adaptive_en(char *string,
               short *ptable,
               short *s,
               short *s1,
+              const pair_info *pairs,
+              int energy,
               int verbosity_level){
 
   srand(time(NULL));
 
   Encoded enc;
   enc.seq = string;
+  enc.pairs = pairs;
+  enc.paired = (uint64_t*) space(sizeof(uint64_t)*pairs->words);
   enc.s0 = s;
   enc.s1 = s1;
 
@@ -906,6 +1006,7 @@ move_adaptive(char *string,
 
   /* function */
   enc.funct=NULL;
+  select_kernel(&enc, 1);
 
   /* allocate memory for moves */
   enc.moves_from = (int*) space(ptable[0]*ptable[0]*sizeof(int));
@@ -916,21 +1017,37 @@ move_adaptive(char *string,
 
   struct_en str;
   str.structure = allocopy(ptable);
-  str.energy = energy_of_structure_pt(enc.seq, str.structure, enc.s0, enc.s1, 0);
+  str.energy = energy;
 
-  while (move_rset(&enc, &str)!=0) {
+  last_steps = 0;
+  while (enc.kernel(&enc, &str)!=0) {
+    last_steps++;
     free_degen(&enc);
   }
   free_degen(&enc);
 
   copy_arr(ptable, str.structure);
   free(str.structure);
+  free(enc.paired);
   free(enc.moves_from);
   free(enc.moves_to);
 
   return str.energy;
 }
 
+PUBLIC int
+move_adaptive(char *string,
+              short *ptable,
+              short *s,
+              short *s1,
+              int verbosity_level){
+
+  pair_info *pairs = pair_info_new(string);
+  int energy = move_adaptive_en(string, ptable, s, s1, pairs, energy_of_structure_pt(string, ptable, s, s1, 0), verbosity_level);
+  pair_info_free(pairs);
+  return energy;
+}
+
 PUBLIC int
 browse_neighs(char *seq,
               char *struc,
@@ -944,7 +1061,6 @@ browse_neighs(char *seq,
   short int *s0 = encode_sequence(seq, 0);
   short int *s1 = encode_sequence(seq, 1);
   short int *str = make_pair_table(struc);
-
   int res = browse_neighs_pt(seq, str, s0, s1, verbosity_level, shifts, noLP, funct);
 
   free(s0);
@@ -955,10 +1071,11 @@ browse_neighs(char *seq,
 }
 
 PUBLIC int
-browse_neighs_pt( char *string,
+browse_neighs_en( char *string,
                   short *ptable,
                   short *s,
                   short *s1,
+                  const pair_info *pairs,
                   int verbosity_level,
                   int shifts,
                   int noLP,
@@ -966,6 +1083,8 @@ browse_neighs_pt( char *string,
 
   Encoded enc;
   enc.seq = string;
+  enc.pairs = pairs;
+  enc.paired = (uint64_t*) space(sizeof(uint64_t)*pairs->words);
   enc.s0 = s;
   enc.s1 = s1;
 
@@ -990,6 +1109,7 @@ browse_neighs_pt( char *string,
 
   /* function */
   enc.funct=funct;
+  select_kernel(&enc, 0);
 
   int i;
   for (i=0; i<MAX_DEGEN; i++) enc.processed[i]=enc.unprocessed[i]=NULL;
@@ -998,15 +1118,32 @@ browse_neighs_pt( char *string,
   str.structure = allocopy(ptable);
   str.energy = energy_of_structure_pt(enc.seq, str.structure, enc.s0, enc.s1, 0);
 
-  move_set(&enc, &str);
+  enc.kernel(&enc, &str);
   free_degen(&enc);
 
   copy_arr(ptable, str.structure);
   free(str.structure);
+  free(enc.paired);
 
   return str.energy;
 }
 
+PUBLIC int
+browse_neighs_pt( char *string,
+                  short *ptable,
+                  short *s,
+                  short *s1,
+                  int verbosity_level,
+                  int shifts,
+                  int noLP,
+                  int (*funct) (struct_en*, struct_en*)){
+
+  pair_info *pairs = pair_info_new(string);
+  int res = browse_neighs_en(string, ptable, s, s1, pairs, verbosity_level, shifts, noLP, funct);
+  pair_info_free(pairs);
+  return res;
+}
+
 /* printf */
 PUBLIC void
 print_stren(FILE *out, struct_en *str) {
@@ -3,6 +3,8 @@
 
 #include <stdio.h>
 
+#include "pair_info.h"
+
 /* used data structure*/
 typedef struct _struct_en{
   int energy;        /* energy in 10kcal/mol*/
@@ -48,6 +50,38 @@ int move_adaptive(  char *seq,
                 short *s1,
                 int verbosity_level);
 
+/* same as above, but energy of ptable is given by the caller (saves one full energy evaluation)
+    input:    pairs - pairing table of seq (pair_info_new(), SeqInfo::pairs)
+              energy - energy of ptable in 10kcal/mol (as from energy_of_structure_pt()) */
+int move_gradient_en( char *seq,
+                  short *ptable,
+                  short *s,
+                  short *s1,
+                  const pair_info *pairs,
+                  int energy,
+                  int verbosity_level,
+                  int shifts,
+                  int noLP);
+int move_first_en( char *seq,
+                short *ptable,
+                short *s,
+                short *s1,
+                const pair_info *pairs,
+                int energy,
+                int verbosity_level,
+                int shifts,
+                int noLP);
+int move_adaptive_en(  char *seq,
+                short *ptable,
+                short *s,
+                short *s1,
+                const pair_info *pairs,
+                int energy,
+                int verbosity_level);
+
+/* number of moves of the last walk (above methods) in the calling thread */
+int move_last_steps();
+
 /* standardized method that encapsulates above "_pt" methods
   input:  seq - sequence
           struc - structure in dot-bracket notation
@@ -78,6 +112,17 @@ int browse_neighs_pt( char *seq,
                    int noLP,
                    int (*funct) (struct_en*, struct_en*));
 
+/* same as above, with the pairing table of seq given by the caller (pair_info_new(), SeqInfo::pairs) */
+int browse_neighs_en( char *seq,
+                   short *ptable,
+                   short *s,
+                   short *s1,
+                   const pair_info *pairs,
+                   int verbosity_level,
+                   int shifts,
+                   int noLP,
+                   int (*funct) (struct_en*, struct_en*));
+
 int browse_neighs( char *seq,
                    char *struc,
                    int verbosity_level,
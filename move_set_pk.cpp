@@ -6,6 +6,7 @@
 #include <time.h>
 
 #include "move_set_pk.h"
+#include "pair_info.h"
 
 extern "C" {
   #include "pair_mat.h"
@@ -60,6 +61,7 @@ int lone_base(short *pt, int i);
 typedef struct _Encoded {
   // sequence
   const char  *seq;
+  const pair_info *pairs;   // pairing tables of seq
   short *s0;
   short *s1;
 
@@ -235,42 +237,26 @@ int deletions_pk(Encoded *Enc, Structure *str, Structure *minim)
   return cnt;
 }
 
-  /* compatible base pair?*/
-inline bool compat(char a, char b) {
-  if (a=='A' && b=='U') return true;
-  if (a=='C' && b=='G') return true;
-  if (a=='G' && b=='U') return true;
-  if (a=='U' && b=='A') return true;
-  if (a=='G' && b=='C') return true;
-  if (a=='U' && b=='G') return true;
-  /* and with T's*/
-  if (a=='A' && b=='T') return true;
-  if (a=='T' && b=='A') return true;
-  if (a=='G' && b=='T') return true;
-  if (a=='T' && b=='G') return true;
-  return false;
-}
-
 /* try insert base pair (i,j)*/
-inline bool try_insert(const short *pt, const char *seq, int i, int j)
+inline bool try_insert(const short *pt, const pair_info *pairs, int i, int j)
 {
   if (i<=0 || j<=0 || i>pt[0] || j>pt[0]) return false;
-  return (j-i>MINGAP && pt[j]==0 && pt[i]==0 && compat(seq[i-1], seq[j-1]));
+  return (j-i>MINGAP && pt[j]==0 && pt[i]==0 && pair_ok(pairs, i, j));
 }
 
 /* try switch base pair (i,j)*/
-inline bool try_shift(const short *pt, const char *seq, int i, int j)
+inline bool try_shift(const short *pt, const pair_info *pairs, int i, int j)
 {
   if (i<=0 || j<=0 || i>pt[0] || j>pt[0]) return false;
-  return (j-i>MINGAP && compat(seq[i-1], seq[j-1]) &&
+  return (j-i>MINGAP && pair_ok(pairs, i, j) &&
           ((pt[i]==0 && pt[j]!=0) || (pt[i]!=0 && pt[j]==0)) );
 }
 
 // try insert base pair (i,j)
-inline bool try_insert_seq(const char *seq, int i, int j)
+inline bool try_insert_seq(const pair_info *pairs, int i, int j)
 {
   if (i<=0 || j<=0) return false;
-  return (j-i>MINGAP && compat(seq[i-1], seq[j-1]));
+  return (j-i>MINGAP && pair_ok(pairs, i, j));
 }
 
 /* insertions move set*/
@@ -283,7 +269,7 @@ int insertions_pk(Encoded *Enc, Structure *str, Structure *minim)
 
   for (i=1; i<=len; i++) {
     if (pt[i]==0) {
-      for (j=i+1; j<=len; j++) {
+      for (j=pair_next(Enc->pairs, NULL, i, i+1, len); j; j=pair_next(Enc->pairs, NULL, i, j+1, len)) {
         /* end if found closing bracket*/
         //if (pt[j]!=0 && pt[j]<j) break;  //')'
         /*if (pt[j]!=0 && pt[j]>j) {       //'('
@@ -291,7 +277,7 @@ int insertions_pk(Encoded *Enc, Structure *str, Structure *minim)
           continue;
         }*/
         /* if conditions are met, do insert*/
-        if (try_insert(pt, Enc->seq, i, j)) {
+        if (try_insert(pt, Enc->pairs, i, j)) {
           INS_FLAG iflag = str->CanInsert(i, j);
           if (iflag != NO_INS && (Enc->all_neighs || iflag == REG_INS || iflag == INSIDE_PK)) {
             Enc->bp_left=i;
@@ -331,9 +317,9 @@ int shifts_pk(Encoded *Enc, Structure *str, Structure *minim)
     // first '('
     if (pt[i]>i) {
 
-      for (j=i+1; j<=len; j++) {
+      for (j=pair_next(Enc->pairs, NULL, i, i+1, len); j; j=pair_next(Enc->pairs, NULL, i, j+1, len)) {
 
-        if (try_shift(pt, Enc->seq, i, j)) {
+        if (try_shift(pt, Enc->pairs, i, j)) {
           INS_FLAG iflag = str->CanShift(i, j);
           if (iflag != NO_INS && (Enc->all_neighs || iflag == REG_INS || iflag == INSIDE_PK)) {
             Enc->bp_left=i;
@@ -354,7 +340,7 @@ int shifts_pk(Encoded *Enc, Structure *str, Structure *minim)
     if (pt[i]<i) {
       for (j=1; j<i; j++) {
 
-        if (try_shift(pt, Enc->seq, i, j)) {
+        if (try_shift(pt, Enc->pairs, i, j)) {
           INS_FLAG iflag = str->CanShift(i, j);
           if (iflag != NO_INS && (Enc->all_neighs || iflag == REG_INS || iflag == INSIDE_PK)) {
             Enc->bp_left=i;
@@ -459,10 +445,10 @@ void construct_moves(Encoded *Enc, short *structure)
       //fprintf(stderr, "add  d(%d, %d)\n", i, str.structure[i]);
     } else {
       int j;
-      for (j=i+1; j<=structure[0]; j++) {
+      for (j=pair_next(Enc->pairs, NULL, i, i+1, structure[0]); j; j=pair_next(Enc->pairs, NULL, i, j+1, structure[0])) {
         //fprintf(stderr, "check (%d, %d)\n", i, j);
         if (structure[j]==0) {
-          if (try_insert_seq(Enc->seq,i,j)) {
+          if (try_insert_seq(Enc->pairs,i,j)) {
             Enc->moves_from[Enc->num_moves]=i;
             Enc->moves_to[Enc->num_moves]=j;
             Enc->num_moves++;
@@ -577,14 +563,15 @@ int move_standard_pk_pt(const char *seq,
                   Structure *str,
                   short *s0,
                   short *s1,
+                  const pair_info *pairs,
                   enum MOVE_TYPE type,
                   int shifts,
                   int verbosity_level)
 {
   switch (type){
-  case GRADIENT: move_gradient_pk(seq, str, s0, s1, shifts, verbosity_level); break;
-  case FIRST: move_first_pk(seq, str, s0, s1, shifts, verbosity_level); break;
-  case ADAPTIVE: move_adaptive_pk(seq, str, s0, s1, shifts, verbosity_level); break;
+  case GRADIENT: move_gradient_pk(seq, str, s0, s1, pairs, shifts, verbosity_level); break;
+  case FIRST: move_first_pk(seq, str, s0, s1, pairs, shifts, verbosity_level); break;
+  case ADAPTIVE: move_adaptive_pk(seq, str, s0, s1, pairs, shifts, verbosity_level); break;
   }
 
   return str->energy;
@@ -600,10 +587,13 @@ int move_standard_pk(const char *seq,
   short *s0 = encode_sequence(seq, 0);
   short *s1 = encode_sequence(seq, 1);
 
+  pair_info *pairs = pair_info_new(seq);
+
   Structure *str = new Structure(seq, struc, s0, s1);
 
-  int energy = move_standard_pk_pt(seq, str, s0, s1, type, shifts, verbosity_level);
+  int energy = move_standard_pk_pt(seq, str, s0, s1, pairs, type, shifts, verbosity_level);
 
+  pair_info_free(pairs);
   free(s0);
   free(s1);
 
@@ -617,6 +607,7 @@ int move_gradient_pk(const char *seq,
                   Structure *str,
                   short *s0,
                   short *s1,
+                  const pair_info *pairs,
                   int shifts,
                   int verbosity_level)
 {
@@ -624,6 +615,7 @@ int move_gradient_pk(const char *seq,
 
   Encoded enc;
   enc.seq = seq;
+  enc.pairs = pairs;
   enc.s0 = s0;
   enc.s1 = s1;
 
@@ -667,6 +659,7 @@ int move_first_pk(const char *seq,
                   Structure *str,
                   short *s0,
                   short *s1,
+                  const pair_info *pairs,
                   int shifts,
                   int verbosity_level)
 {
@@ -674,6 +667,7 @@ int move_first_pk(const char *seq,
 
   Encoded enc;
   enc.seq = seq;
+  enc.pairs = pairs;
   enc.s0 = s0;
   enc.s1 = s1;
 
@@ -712,6 +706,7 @@ int move_adaptive_pk(const char *seq,
                   Structure *str,
                   short *s0,
                   short *s1,
+                  const pair_info *pairs,
                   int shifts,
                   int verbosity_level)
 {
@@ -721,6 +716,7 @@ int move_adaptive_pk(const char *seq,
 
   Encoded enc;
   enc.seq = seq;
+  enc.pairs = pairs;
   enc.s0 = s0;
   enc.s1 = s1;
 
@@ -774,10 +770,13 @@ int browse_neighs_pk( const char *seq,
   short *s0 = encode_sequence(seq, 0);
   short *s1 = encode_sequence(seq, 1);
 
+  pair_info *pairs = pair_info_new(seq);
+
   Structure *str = new Structure(seq, struc, s0, s1);
 
-  int res = browse_neighs_pk_pt(seq, str, s0, s1, shifts, verbosity_level, funct);
+  int res = browse_neighs_pk_pt(seq, str, s0, s1, pairs, shifts, verbosity_level, funct);
 
+  pair_info_free(pairs);
   free(s0);
   free(s1);
 
@@ -790,6 +789,7 @@ int browse_neighs_pk_pt(const char *seq,
                   Structure *str,
                   short *s0,
                   short *s1,
+                  const pair_info *pairs,
                   int shifts,
                   int verbosity_level,
                   int (*funct) (Structure*, Structure*))
@@ -798,6 +798,7 @@ int browse_neighs_pk_pt(const char *seq,
 
   Encoded enc;
   enc.seq = seq;
+  enc.pairs = pairs;
   enc.s0 = s0;
   enc.s1 = s1;
 
@@ -13,6 +13,7 @@ extern "C" {
     input:    seq - sequence
               ptable - structure encoded with make_pair_table() from pair_mat.h
               s, s1 - sequence encoded with encode_sequence from pair_mat.h
+              pairs - pairing table of seq (pair_info_new(), SeqInfo::pairs)
     methods:  deepest - lowest energy structure is used
               first - first found lower energy structure is used
               rand - random lower energy structure is used
@@ -22,21 +23,27 @@ int move_gradient_pk(const char *seq,
                   Structure *str,
                   short *s0,
                   short *s1,
+                  const pair_info *pairs,
                   int shifts,
                   int verbosity_level);
 int move_first_pk(const char *seq,
                   Structure *str,
                   short *s0,
                   short *s1,
+                  const pair_info *pairs,
                   int shifts,
                   int verbosity_level);
 int move_adaptive_pk(const char *seq,
                   Structure *str,
                   short *s0,
                   short *s1,
+                  const pair_info *pairs,
                   int shifts,
                   int verbosity_level);
 
+/* number of calls of the move set in the last walk (moves + 1, more with degeneracy) */
+int count_move();
+
 /* standardized method that encapsulates above "_pt" methods
   input:  seq - sequence
           struc - structure in dot-bracket notation
@@ -54,6 +61,7 @@ int move_standard_pk_pt(const char *seq,
                   Structure *str,
                   short *s0,
                   short *s1,
+                  const pair_info *pairs,
                   enum MOVE_TYPE type,
                   int shifts,
                   int verbosity_level);
@@ -62,12 +70,14 @@ int move_standard_pk_pt(const char *seq,
     input:    seq - sequence
               ptable - structure encoded with make_pair_table() from pair_mat.h
               s, s1 - sequence encoded with encode_sequence from pair_mat.h
+              pairs - pairing table of seq (pair_info_new(), SeqInfo::pairs)
               funct - function (structure from neighbourhood, structure from input) toperform on every structure in neigbourhood (if the function returns non-zero, the iteration through neighbourhood stops.)
     returns energy of the structure funct sets as second argument*/
 int browse_neighs_pk_pt(const char *seq,
                    Structure  *str,
                    short *s0,
                    short *s1,
+                   const pair_info *pairs,
                    int shifts,
                    int verbosity_level,
                    int (*funct) (Structure*, Structure*));
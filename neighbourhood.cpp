@@ -7,6 +7,7 @@
 #include "neighbourhood.h"
 #include "RNAlocmin.h"
 #include "hash_util.h"
+#include "profile.h"
 
 extern "C" {
   #include "move_set_inside.h"
@@ -18,6 +19,7 @@ extern "C" {
 
 // declare static members:
 char *Neighborhood::seq = NULL;
+const pair_info *Neighborhood::pairs = NULL;
 short *Neighborhood::s0 = NULL;
 short *Neighborhood::s1 = NULL;
 int Neighborhood::debug = 0;
@@ -70,24 +72,7 @@ Loop::Loop(int i, int j)
   *this = second;
 }*/
 
-inline bool
-compat(char a, char b){
-
-  if (a=='A' && b=='U') return true;
-  if (a=='C' && b=='G') return true;
-  if (a=='G' && b=='U') return true;
-  if (a=='U' && b=='A') return true;
-  if (a=='G' && b=='C') return true;
-  if (a=='U' && b=='G') return true;
-  /* and with T's*/
-  if (a=='A' && b=='T') return true;
-  if (a=='T' && b=='A') return true;
-  if (a=='G' && b=='T') return true;
-  if (a=='T' && b=='G') return true;
-  return false;
-}
-
-int Loop::GenNeighs(char *seq, short *pt)
+int Loop::GenNeighs(const pair_info *pairs, short *pt)
 {
   neighs.clear();
   int res = -1;
@@ -103,7 +88,7 @@ int Loop::GenNeighs(char *seq, short *pt)
         j = pt[j];
         continue;
       }
-      if (j-i>MINGAP && pt[j] == 0 && compat(seq[i-1], seq[j-1])) {
+      if (pt[j] == 0 && pair_ok(pairs, i, j)) {
         neighs.push_back(Neigh(i,j));
       }
     }
@@ -120,6 +105,7 @@ int Loop::EvalLoop(short *pt, short *s0, short *s1, bool inside)
     for (int i=0; i<(int)neighs.size(); i++) {
       pt[neighs[i].i] = neighs[i].j;
       pt[neighs[i].j] = neighs[i].i;
+      PROF_COUNT(PROF_MOVE);
       neighs[i].energy_change = -energy + loop_energy(pt, s0, s1, neighs[i].i) + loop_energy(pt, s0, s1, left);
       pt[neighs[i].i] = 0;
       pt[neighs[i].j] = 0;
@@ -138,10 +124,11 @@ void debug_loops(std::vector<Loop*> &loops)
   }
 }
 
-Neighborhood::Neighborhood(char *seq_in, short *s0, short *s1, short *pt, bool eval)
+Neighborhood::Neighborhood(char *seq_in, short *s0, short *s1, const pair_info *pairs_in, short *pt, bool eval)
 {
   this->pt = allocopy(pt);
   this->seq = seq_in;
+  pairs = pairs_in;
   /*
   seq = (char*)malloc((strlen(seq_in)+1)*sizeof(char));
   strcpy(seq, seq_in);*/
@@ -158,7 +145,7 @@ Neighborhood::Neighborhood(char *seq_in, short *s0, short *s1, short *pt, bool e
   // generate the external loop
   Loop *newone = new Loop(0, pt[0]+1);
   loops[0] = newone;
-  int i = newone->GenNeighs(seq, pt);
+  int i = newone->GenNeighs(pairs, pt);
 
   // generate the neighbourhood (inserts)
   if (i != -1) {
@@ -166,7 +153,7 @@ Neighborhood::Neighborhood(char *seq_in, short *s0, short *s1, short *pt, bool e
       if (pt[i] != 0 && pt[i]>i) {
         Loop *newone = new Loop(i, pt[i]);
         loops[i] = newone;
-        int k = newone->GenNeighs(seq, pt);
+        int k = newone->GenNeighs(pairs, pt);
 
         // jump to next -- either inside or outside
         if (k!=-1) i = k-1;
@@ -259,7 +246,7 @@ int Neighborhood::AddBase(int i, int j, bool reeval)
   if (loops[i]) error_message("Loop %3d already set!!!", i);
   Loop* newloop = new Loop(i,j);
   loops[i] = newloop;
-  newloop->GenNeighs(seq, pt);
+  newloop->GenNeighs(pairs, pt);
   pt[i] = j;
   pt[j] = i;
   int energy_chng = 0;
@@ -267,7 +254,7 @@ int Neighborhood::AddBase(int i, int j, bool reeval)
 
   // delete the neighbors that are wrong now (can be better)
   if (reeval) energy_chng -= loops[beg]->energy;
-  loops[beg]->GenNeighs(seq, pt);
+  loops[beg]->GenNeighs(pairs, pt);
   if (reeval) energy_chng += loops[beg]->EvalLoop(pt, s0, s1, true);
 
   // update energy
@@ -299,7 +286,7 @@ int Neighborhood::RemBase(int i, int j, bool reeval)
 
   // recompute the upper one:
   if (reeval) energy_chng -= loops[upper]->energy;
-  loops[upper]->GenNeighs(seq, pt);
+  loops[upper]->GenNeighs(pairs, pt);
   if (reeval) energy_chng += loops[upper]->EvalLoop(pt, s0, s1, true);
   size += loops[upper]->neighs.size();
 
@@ -371,6 +358,7 @@ int Neighborhood::RemEnergy(short *pt, int loop, int last_loop)
   // resolve energy:
   pt[loops[loop]->left] = 0;
   pt[loops[loop]->right] = 0;
+  PROF_COUNT(PROF_MOVE);
   int change = -loops[loop]->energy - loops[last_loop]->energy + loop_energy(pt, s0, s1, loops[last_loop]->left);
   pt[loops[loop]->left] = loops[loop]->right;
   pt[loops[loop]->right] = loops[loop]->left;
@@ -684,8 +672,10 @@ void test()
   short *s0 = encode_sequence(seq, 0);
   short *s1 = encode_sequence(seq, 1);
 
-  Neighborhood nh0(seq, s0, s1, pt0);
-  Neighborhood nh1(seq, s0, s1, pt1);
+  pair_info *pairs = pair_info_new(seq);
+
+  Neighborhood nh0(seq, s0, s1, pairs, pt0);
+  Neighborhood nh1(seq, s0, s1, pairs, pt1);
 
   fprintf(stderr, "%d\n", nh0 < nh1);
   //nh.EvalNeighs(true);
@@ -704,6 +694,7 @@ void test()
   free(pt1);
   free(s0);
   free(s1);
+  pair_info_free(pairs);
   free_arrays();
   Neighborhood::ClearStatic();
 }
@@ -3,6 +3,8 @@
 #include <vector>
 #include <string>
 
+#include "pair_info.h"
+
 // ###############
 // Neighborhood routines -- note that if you need to have more INDEPENDENT instances of Neighborhood with different degeneracies, you would have to do a bit of coding... since they are static now and need to be static.
 // ###############
@@ -35,7 +37,7 @@ struct Loop
   Loop(int i, int j);
   //Loop(Loop &second);
 
-  int GenNeighs(char *seq, short *pt);  // return next loop inside, -1 if not found
+  int GenNeighs(const pair_info *pairs, short *pt);  // return next loop inside, -1 if not found
   int EvalLoop(short *pt, short *s0, short *s1, bool inside); // return energy of loop (as from loop_energy() )
 };
 
@@ -43,6 +45,7 @@ class Neighborhood
 {
 private:
   static char *seq;
+  static const pair_info *pairs;
   static short *s0;
   static short *s1;
 
@@ -66,7 +69,7 @@ public:
   static int debug;
 
 public:
-  Neighborhood(char *seq, short *s0, short *s1, short *pt, bool eval = true);
+  Neighborhood(char *seq, short *s0, short *s1, const pair_info *pairs, short *pt, bool eval = true);
   Neighborhood(const Neighborhood &second);
   ~Neighborhood();
 
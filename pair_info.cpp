@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pair_info.h"
+
+// compatible base pair? (the same as in move sets - GU and T's included)
+static inline bool compat(char a, char b)
+{
+  if (a=='A' && b=='U') return true;
+  if (a=='C' && b=='G') return true;
+  if (a=='G' && b=='U') return true;
+  if (a=='U' && b=='A') return true;
+  if (a=='G' && b=='C') return true;
+  if (a=='U' && b=='G') return true;
+  /* and with T's*/
+  if (a=='A' && b=='T') return true;
+  if (a=='T' && b=='A') return true;
+  if (a=='G' && b=='T') return true;
+  if (a=='T' && b=='G') return true;
+  return false;
+}
+
+pair_info *pair_info_new(const char *seq)
+{
+  pair_info *pi = (pair_info*) malloc(sizeof(pair_info));
+  int n = strlen(seq);
+  pi->length = n;
+  pi->words = (n+1+63)/64;
+  pi->bits = (uint64_t*) calloc((size_t)(n+1)*pi->words, sizeof(uint64_t));
+
+  for (int i=1; i<=n; i++) {
+    uint64_t *row = pi->bits + (size_t)i*pi->words;
+    for (int j=1; j<=n; j++) {
+      if (abs(i-j)>PAIR_MINGAP && compat(seq[i-1], seq[j-1])) row[j>>6] |= (uint64_t)1 << (j&63);
+    }
+  }
+  return pi;
+}
+
+void pair_info_free(pair_info *pi)
+{
+  if (pi == NULL) return;
+  free(pi->bits);
+  free(pi);
+}
+
+int pair_next(const pair_info *pi, const uint64_t *mask, int i, int from, int to)
+{
+  if (from>to) return 0;
+  const uint64_t *row = pi->bits + (size_t)i*pi->words;
+  int w = from>>6;
+  int w_end = to>>6;
+  uint64_t word = (row[w] | (mask ? mask[w] : 0)) & (~(uint64_t)0 << (from&63));
+  while (true) {
+    if (word) {
+      int k = (w<<6) + __builtin_ctzll(word);
+      return k<=to ? k : 0;
+    }
+    if (++w > w_end) return 0;
+    word = row[w] | (mask ? mask[w] : 0);
+  }
+}
+
+void pair_mask(const pair_info *pi, const short *pt, uint64_t *mask)
+{
+  memset(mask, 0, sizeof(uint64_t)*pi->words);
+  for (int i=1; i<=pt[0]; i++) {
+    if (pt[i]) mask[i>>6] |= (uint64_t)1 << (i&63);
+  }
+}
@@ -0,0 +1,41 @@
+#ifndef __PAIR_INFO_H
+#define __PAIR_INFO_H
+
+#include <stdint.h>
+
+/* minimal number of unpaired bases in a hairpin (same as MINGAP in move sets) */
+#define PAIR_MINGAP 3
+
+/* per-sequence pairing table, built once for a sequence (SeqInfo::Init) and read-only afterwards:
+    bits - row i (words 64-bit words) has bit j set if bases i and j can pair (AU, CG, GU, also with T) and |i-j|>PAIR_MINGAP */
+typedef struct _pair_info {
+  int length;
+  int words;
+  uint64_t *bits;
+} pair_info;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* build the table for the sequence (owned by the caller, free with pair_info_free) */
+pair_info *pair_info_new(const char *seq);
+void pair_info_free(pair_info *pi);
+
+/* lowest k in <from, to> that can pair with i or has bit set in mask (can be NULL), 0 if none */
+int pair_next(const pair_info *pi, const uint64_t *mask, int i, int from, int to);
+
+/* fill mask (pi->words words) with positions paired in pt */
+void pair_mask(const pair_info *pi, const short *pt, uint64_t *mask);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* can i and j pair? */
+static inline int pair_ok(const pair_info *pi, int i, int j)
+{
+  return (int)((pi->bits[i*pi->words + (j>>6)] >> (j&63)) & 1);
+}
+
+#endif
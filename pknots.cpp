@@ -17,8 +17,8 @@ extern "C" {
 }
 
 #include "pknots.h"
+#include "profile.h"
 
-static float time_eos = 0.0;
 static paramT *P = NULL;
 
 void freeP()
@@ -27,11 +27,6 @@ void freeP()
   P = NULL;
 }
 
-float get_eos_time()
-{
-  return time_eos;
-}
-
 // ################ issue: TODO GU pair on end adds 0.5 penalty....
 
 inline int Ext_Loop(int p, int q, short *s0, paramT *P)
@@ -549,7 +544,7 @@ int energy_of_struct_pk(const char *seq, short *structure, int verbose)
 
 int energy_of_struct_pk(const char *seq, short *structure, short *s0, short *s1, int verbose)
 {
-  clock_t time = clock();
+  PROF_START(prof_time);
 
   if (P == NULL) {
     make_pair_matrix();
@@ -582,15 +577,15 @@ int energy_of_struct_pk(const char *seq, short *structure, short *s0, short *s1,
   int ext = loop_energy_pk(0, str, s0, s1, P, multiloop);
   energy += ext;
 
-  string type;
-  for (int i=1; i<=str[0]; i++) {
-    type += bpair_type_sname[hlps.str_type[i]];
-  }
+  if (verbose) {
+    string type;
+    for (int i=1; i<=str[0]; i++) {
+      type += bpair_type_sname[hlps.str_type[i]];
+    }
 
-  if (verbose) fprintf(stderr, "%s\n%s", seq, pt_to_str_pk(structure).c_str());
-  if (verbose) fprintf(stderr, " %7.2f\n%s\n", energy/100.0, type.c_str());
+    fprintf(stderr, "%s\n%s", seq, pt_to_str_pk(structure).c_str());
+    fprintf(stderr, " %7.2f\n%s\n", energy/100.0, type.c_str());
 
-  if (verbose) {
     int summ = ext;
     fprintf(stderr, "%7.2f EXT\n", ext/100.0);
     for (int i=1; i<=str[0]; i++) {
@@ -601,9 +596,7 @@ int energy_of_struct_pk(const char *seq, short *structure, short *s0, short *s1,
     fprintf(stderr, "%7.2f summed\n", summ/100.0);
   }
 
-  float time_tmp = (clock()-time)/(double)CLOCKS_PER_SEC;
-  //fprintf(stderr, "time_tmp = %10g\n", time_tmp);
-  time_eos += time_tmp;
+  PROF_STOP(PROF_EOS, prof_time);
 
   return energy;
 }
@@ -611,120 +604,232 @@ int energy_of_struct_pk(const char *seq, short *structure, short *s0, short *s1,
 
 Pseudoknot::Pseudoknot()
 {
-  for (int i=0; i<4; i++)
+  for (int i=0; i<4; i++) {
     for (int j=0; j<4; j++) imat[i][j] = false;
+    first[i] = last[i] = count[i] = 0;
+  }
 
   size = 0;
 }
-/*
-// constructor
-Pseudoknot::Pseudoknot(int left, int right, int k)
-{
-  assert(left>0);
-  if (left > right) swap(left, right);
-  if (k && left > k) swap(left, k);
-  if (k && k > right) swap(k, right);
-
-  for (int i=0; i<4; i++)
-    for (int j=0; j<4; j++) imat[i][j] = false;
 
-  int pos_right = k?2:1;
+bool IsViable(int size, bool imat[4][4]) {
+/*PH    PK    PL    PM
+  0100  0100  0110  0110
+  0000  0010  0010  0011
+  0000  0000  0000  0001
+  0000  0000  0000  0000*/
 
-  parts[0].insert(left);
-  parts[pos_right].insert(right);
+  if (size == 2) return true;
+  if (size == 3) return true;
+  if (size == 4) {
+    return imat[0][1] && imat[0][2] && !imat[0][3] &&
+           imat[1][2] && imat[1][3] &&
+           imat[2][3];
+  }
+  return false;
+}
 
-  imat[0][pos_right] = 1;
+// ################ parts of pknots (flat layout)
 
-  if (k) {
-    parts[1].insert(k);
-    imat[0][1] = 1;
-    imat[1][pos_right] = 1;
+void Structure::PartInsert(int pk, int part, int left)
+{
+  Pseudoknot &pknot = pknots[pk];
+  pk_part[left] = pk*4 + part;
+  if (pknot.count[part]==0) {
+    pknot.first[part] = pknot.last[part] = left;
+  } else {
+    pknot.first[part] = min(pknot.first[part], left);
+    pknot.last[part] = max(pknot.last[part], left);
   }
-}*/
+  pknot.count[part]++;
+}
 
-// contains some bpair?
-bool Pseudoknot::Contains(int left)
+void Structure::PartErase(int left)
 {
-  return parts[0].count(left) || parts[1].count(left) || parts[2].count(left)|| parts[3].count(left);
+  int pk = pk_part[left]/4;
+  int part = pk_part[left]%4;
+  Pseudoknot &pknot = pknots[pk];
+  pk_part[left] = -1;
+  pknot.count[part]--;
+  if (pknot.count[part]==0) {
+    pknot.first[part] = pknot.last[part] = 0;
+  } else {
+    if (left == pknot.first[part]) pknot.first[part] = PartNext(pk, part, left);
+    if (left == pknot.last[part]) pknot.last[part] = PartPrev(pk, part, left);
+  }
 }
 
-/*bool cross(int left, int right, int left2, int right2) {
-  return (left<left2 && right<right2 && left2<right) ||
-         (left>left2 && right>right2 && right2>left);
+void Structure::PartMove(int pk, int part, int new_pk, int new_part)
+{
+  Pseudoknot &pknot = pknots[pk];
+  short code = pk*4 + part;
+  short new_code = (new_pk<0 ? -1 : new_pk*4 + new_part);
+  if (pknot.count[part]) {
+    for (int i=pknot.first[part]; i<=pknot.last[part]; i++) {
+      if (pk_part[i] == code) pk_part[i] = new_code;
+    }
+  }
+  if (new_pk>=0) {
+    Pseudoknot &dest = pknots[new_pk];
+    dest.first[new_part] = pknot.first[part];
+    dest.last[new_part] = pknot.last[part];
+    dest.count[new_part] = pknot.count[part];
+  }
 }
 
-bool Pseudoknot::Cross(short *str, int left, int right)
+int Structure::PartNext(int pk, int part, int pos)
 {
-  int left2 = *parts[0].begin();
-  if (cross(left, right, left2, str[left2])) return true;
-  left2 = *parts[1].begin();
-  if (cross(left, right, left2, str[left2])) return true;
-  if (parts[2].empty()) return false;
-  left2 = *parts[2].begin();
-  if (cross(left, right, left2, str[left2])) return true;
-  if (parts[3].empty()) return false;
-  left2 = *parts[3].begin();
-  if (cross(left, right, left2, str[left2])) return true;
-  return false;
-}*/
-
+  short code = pk*4 + part;
+  for (int i=max(pos+1, pknots[pk].first[part]); i<=pknots[pk].last[part]; i++) {
+    if (pk_part[i] == code) return i;
+  }
+  return 0;
+}
 
-  // can we insert it inside?
-int Pseudoknot::Inside(short *str, int left, int right)
+int Structure::PartPrev(int pk, int part, int pos)
 {
-  for (int i=0; i<4; i++) {
-    if (parts[i].empty()) return -1;
+  short code = pk*4 + part;
+  for (int i=min(pos, pknots[pk].last[part]); i>=pknots[pk].first[part] && i>0; i--) {
+    if (pk_part[i] == code) return i;
+  }
+  return 0;
+}
 
-    set<int>::iterator it = parts[i].upper_bound(left);
+// ################ crossing index
+
+// bpairs crossing the queried one, split into stacks (at most 4 can be handled by a pknot)
+struct CrossGroups {
+  int num;
+  int first[4];     // lowest left end in a group
+  int back[4];      // last added left end (innermost one for the stack)
+  int count[4];
+  int code[4];      // pk_part of the first added left end
+  bool same_code[4];  // all left ends of a group have the same pk_part
+  bool same_pk[4];    // all left ends of a group are in the same pknot
+  int order[4];     // groups sorted by the first left end
+
+  CrossGroups() : num(0) {}
+
+  // add crossing bpair (left end), return its group or -1 if too many groups
+  //  open: the bpair goes out to the right ('(' inside), otherwise ')' inside
+  int Add(int lft, bool open, const short *str, const short *pk_part) {
+    int k;
+    for (k=0; k<num; k++) {
+      int l = back[k];
+      int r = str[l];
+      if (open ? (lft>l && str[lft]<r) : (lft<l && str[lft]>r)) break;
+    }
+    if (k==num) {
+      if (num==4) return -1;
+      num++;
+      first[k] = lft;
+      count[k] = 0;
+      code[k] = pk_part[lft];
+      same_code[k] = same_pk[k] = true;
+    }
+    back[k] = lft;
+    count[k]++;
+    first[k] = std::min(first[k], lft);
+    if (pk_part[lft] != code[k]) {
+      same_code[k] = false;
+      if (pk_part[lft]<0 || code[k]<0 || pk_part[lft]/4 != code[k]/4) same_pk[k] = false;
+    }
+    return k;
+  }
 
-    // check if we are inside :   it--(..left[..it( ... it)..right]..it--)
-    if ((it == parts[i].end() || str[*it]<right) &&
-        (it == parts[i].begin() || str[*(--it)]>right)) {
-          return i;
+  void Sort() {
+    for (int i=0; i<num; i++) order[i] = i;
+    for (int i=1; i<num; i++) {
+      for (int j=i; j>0 && first[order[j]]<first[order[j-1]]; j--) std::swap(order[j], order[j-1]);
     }
   }
+};
 
-  return -1;
+void Structure::CrossInit(int length)
+{
+  cross_m = 1;
+  while (cross_m < length+1) cross_m *= 2;
+  cross_open = (short*) malloc(sizeof(short)*4*cross_m);
+  cross_close = cross_open + 2*cross_m;
+  for (int i=0; i<2*cross_m; i++) {
+    cross_open[i] = 0;
+    cross_close[i] = SHRT_MAX;
+  }
 }
 
-bool IsViable(int size, bool imat[4][4]) {
-/*PH    PK    PL    PM
-  0100  0100  0110  0110
-  0000  0010  0010  0011
-  0000  0000  0000  0001
-  0000  0000  0000  0000*/
+void Structure::CrossUpdate(int pos)
+{
+  int i = cross_m + pos;
+  cross_open[i] = str[pos]>pos ? str[pos] : 0;
+  cross_close[i] = (str[pos]>0 && str[pos]<pos) ? str[pos] : SHRT_MAX;
+  for (i/=2; i>0; i/=2) {
+    cross_open[i] = max(cross_open[2*i], cross_open[2*i+1]);
+    cross_close[i] = min(cross_close[2*i], cross_close[2*i+1]);
+  }
+}
 
-  if (size == 2) return true;
-  if (size == 3) return true;
-  if (size == 4) {
-    return imat[0][1] && imat[0][2] && !imat[0][3] &&
-           imat[1][2] && imat[1][3] &&
-           imat[2][3];
+// visit (left to right) positions in <lo,hi> of the node <nl,nr> with '(' going beyond thr (open) or ')' coming from before thr (!open)
+//  if pk>=0, the visited bpairs are inserted into part_of[group] of the pknot pk
+bool Structure::CrossCollect(int node, int nl, int nr, int lo, int hi, int thr, bool open, CrossGroups &groups, int pk, const int *part_of)
+{
+  if (nr<lo || nl>hi) return true;
+  if (open ? cross_open[node]<=thr : cross_close[node]>=thr) return true;
+  if (nl==nr) {
+    int lft = open ? nl : str[nl];
+    int k = groups.Add(lft, open, str, pk_part);
+    if (k<0) return false;
+    if (pk>=0) PartInsert(pk, part_of[k], lft);
+    return true;
   }
-  return false;
+  int mid = (nl+nr)/2;
+  return CrossCollect(2*node, nl, mid, lo, hi, thr, open, groups, pk, part_of) &&
+         CrossCollect(2*node+1, mid+1, nr, lo, hi, thr, open, groups, pk, part_of);
 }
 
-Pseudoknot::Pseudoknot(const Pseudoknot &pknot)
+// find all bpairs crossing (left, right), false if they cannot form a pknot (too many stacks)
+//  the ')' stacks are found before the '(' ones - they never share a group, so grouping is not affected
+bool Structure::CrossFind(int left, int right, CrossGroups &groups, int pk, const int *part_of)
 {
+  if (!CrossCollect(1, 0, cross_m-1, left+1, right-1, left, false, groups, pk, part_of)) return false;
+  if (!CrossCollect(1, 0, cross_m-1, left+1, right-1, right, true, groups, pk, part_of)) return false;
+  groups.Sort();
+  return true;
+}
+
+  // can we insert it inside?
+int Structure::PknotInside(int pk, int left, int right)
+{
+  Pseudoknot &pknot = pknots[pk];
   for (int i=0; i<4; i++) {
-    for (int j=0; j<4; j++) imat[i][j] = pknot.imat[i][j];
-    parts[i] = pknot.parts[i];
+    if (pknot.count[i]==0) return -1;
+
+    int next = PartNext(pk, i, left);
+    int prev = PartPrev(pk, i, left);
+
+    // check if we are inside :   prev(..left[..next( ... next)..right]..prev)
+    if ((next == 0 || str[next]<right) &&
+        (prev == 0 || str[prev]>right)) {
+          return i;
+    }
   }
-  size = pknot.size;
+
+  return -1;
 }
 
-bool Pseudoknot::CanInsert(int left, vector<int> &numbers, bool insert)
+bool Structure::PknotCanInsert(int pk, int left, vector<int> &numbers, bool insert)
 {
+  Pseudoknot &pknot = pknots[pk];
+  int size = pknot.size;
   if (size==4) return false;
 
   bool imat2[4][4];
   int new_pos = 0;
-  while (!parts[new_pos].empty() && *parts[new_pos].begin()<left) new_pos++;
+  while (pknot.count[new_pos] && pknot.first[new_pos]<left) new_pos++;
   for (int i=0; i<size; i++) {
     for (int j=i+1; j<size; j++) {
       int ii = i >= new_pos ? i+1:i;
       int jj = j >= new_pos ? j+1:j;
-      imat2[ii][jj] = imat[i][j];
+      imat2[ii][jj] = pknot.imat[i][j];
     }
   }
 
@@ -737,15 +842,16 @@ bool Pseudoknot::CanInsert(int left, vector<int> &numbers, bool insert)
   bool viable = IsViable(size+1, imat2);
 
   if (viable && insert) {
-    for (int i=3; i>new_pos; i--) {
-      swap(parts[i], parts[i-1]);
+    for (int i=size-1; i>=new_pos; i--) {
+      PartMove(pk, i, pk, i+1);
     }
-    parts[new_pos].insert(left);
-    size++;
+    pknot.count[new_pos] = 0;
+    PartInsert(pk, new_pos, left);
+    pknot.size++;
 
-    for (int i=0; i<size; i++) {
-      for (int j=i+1; j<size; j++) {
-        imat[i][j] = imat2[i][j];
+    for (int i=0; i<pknot.size; i++) {
+      for (int j=i+1; j<pknot.size; j++) {
+        pknot.imat[i][j] = imat2[i][j];
       }
     }
   }
@@ -753,50 +859,32 @@ bool Pseudoknot::CanInsert(int left, vector<int> &numbers, bool insert)
   return viable;
 }
 
-bool Pseudoknot::Delete(int left)
+bool Structure::PknotDelete(int pk, int left)
 {
-  for (int i=0; i<4; i++) {
-  // try to find it
-    set<int>::iterator it = parts[i].find(left);
-    if (it != parts[i].end()) {
-      // delete it
-      parts[i].erase(it);
-      // change type?
-      if (parts[i].empty()) {
-        size--;
-        if (size==1) return true; // cancelled H type
-        if (size==2 && i==1 && !imat[0][2]) { // cancelled K type
-          size--;
-          return true;
-        }
-        for (int j=0; j<size; j++) {
-          int jj = j>=i?j+1:j;
-          for (int k=j+1; k<size; k++) {
-            int kk = k>=i?k+1:k;
-            imat[j][k] = imat[jj][kk];
-          }
-          parts[j] = parts[jj];
-        }
-        parts[size].clear();
-        imat[0][size] = imat[1][size] = imat[2][size] = false;
-        return true;
-      }
+  Pseudoknot &pknot = pknots[pk];
+  int i = pk_part[left]%4;
+  PartErase(left);
+  // change type?
+  if (pknot.count[i]==0) {
+    pknot.size--;
+    if (pknot.size==1) return true; // cancelled H type
+    if (pknot.size==2 && i==1 && !pknot.imat[0][2]) { // cancelled K type
+      pknot.size--;
       return true;
     }
+    for (int j=0; j<pknot.size; j++) {
+      int jj = j>=i?j+1:j;
+      for (int k=j+1; k<pknot.size; k++) {
+        int kk = k>=i?k+1:k;
+        pknot.imat[j][k] = pknot.imat[jj][kk];
+      }
+      if (jj != j) PartMove(pk, jj, pk, j);
+    }
+    pknot.count[pknot.size] = pknot.first[pknot.size] = pknot.last[pknot.size] = 0;
+    pknot.imat[0][pknot.size] = pknot.imat[1][pknot.size] = pknot.imat[2][pknot.size] = false;
+    return true;
   }
-
-  return false;
-}
-
-Pseudoknot &Pseudoknot::operator=(const Pseudoknot &pknot)
-{
-  for (int i=0; i<4; i++) {
-    for (int j=0; j<4; j++) this->imat[i][j] = pknot.imat[i][j];
-    this->parts[i] = pknot.parts[i];
-  }
-  this->size = pknot.size;
-
-  return *this;
+  return true;
 }
 
 Structure::Structure(int length)
@@ -804,6 +892,11 @@ Structure::Structure(int length)
   this->str = (short*) malloc(sizeof(short)*(length+1));
   for (int i=1; i<=length; i++) this->str[i] = 0;
   this->str[0] = length;
+  this->pk_part = (short*) malloc(sizeof(short)*(length+1));
+  for (int i=1; i<=length; i++) this->pk_part[i] = -1;
+  this->pk_part[0] = length;
+  CrossInit(length);
+  region_hlps = NULL;
 
   this->energy = 0;
 }
@@ -814,6 +907,11 @@ Structure::Structure(short *structure, int energy)
   this->str = (short*) malloc(sizeof(short)*(length+1));
   for (int i=1; i<=length; i++) this->str[i] = 0;
   this->str[0] = length;
+  this->pk_part = (short*) malloc(sizeof(short)*(length+1));
+  for (int i=1; i<=length; i++) this->pk_part[i] = -1;
+  this->pk_part[0] = length;
+  CrossInit(length);
+  region_hlps = NULL;
 
   // assign all bpairs:
   for (int i=1; i<=structure[0]; i++) {
@@ -829,6 +927,11 @@ Structure::Structure(char *structure, int energy)
   this->str = (short*) malloc(sizeof(short)*(length+1));
   for (int i=1; i<=length; i++) this->str[i] = 0;
   this->str[0] = length;
+  this->pk_part = (short*) malloc(sizeof(short)*(length+1));
+  for (int i=1; i<=length; i++) this->pk_part[i] = -1;
+  this->pk_part[0] = length;
+  CrossInit(length);
+  region_hlps = NULL;
 
   // assign all bpairs:
   short *str_tmp = make_pair_table_PK(structure);
@@ -846,6 +949,11 @@ Structure::Structure(const char *seq, short *structure, short *s0, short *s1)
   this->str = (short*) malloc(sizeof(short)*(length+1));
   for (int i=1; i<=length; i++) this->str[i] = 0;
   this->str[0] = length;
+  this->pk_part = (short*) malloc(sizeof(short)*(length+1));
+  for (int i=1; i<=length; i++) this->pk_part[i] = -1;
+  this->pk_part[0] = length;
+  CrossInit(length);
+  region_hlps = NULL;
 
   // assign all bpairs:
   for (int i=1; i<=structure[0]; i++) {
@@ -861,6 +969,11 @@ Structure::Structure(const char *seq, char *structure, short *s0, short *s1)
   this->str = (short*) malloc(sizeof(short)*(length+1));
   for (int i=1; i<=length; i++) this->str[i] = 0;
   this->str[0] = length;
+  this->pk_part = (short*) malloc(sizeof(short)*(length+1));
+  for (int i=1; i<=length; i++) this->pk_part[i] = -1;
+  this->pk_part[0] = length;
+  CrossInit(length);
+  region_hlps = NULL;
 
   // assign all bpairs:
   short *str_tmp = make_pair_table_PK(structure);
@@ -876,15 +989,22 @@ Structure::Structure(const Structure &second)
 {
   energy = second.energy;
   str = allocopy(second.str);
+  pk_part = allocopy(second.pk_part);
+  cross_m = second.cross_m;
+  cross_open = (short*) malloc(sizeof(short)*4*cross_m);
+  cross_close = cross_open + 2*cross_m;
+  memcpy(cross_open, second.cross_open, sizeof(short)*4*cross_m);
+  region_hlps = NULL;
 
   pknots = second.pknots;
-
-  bpair_pknot = second.bpair_pknot;
 }
 
 Structure::~Structure()
 {
   free(str);
+  free(pk_part);
+  free(cross_open);
+  if (region_hlps) delete region_hlps;
 }
 
 bool const Structure::operator<(const Structure &second) const
@@ -918,31 +1038,14 @@ Structure &Structure::operator=(const Structure &second)
 {
   energy = second.energy;
   copy_arr(str, second.str);
+  memcpy(pk_part, second.pk_part, sizeof(short)*(str[0]+1));
+  memcpy(cross_open, second.cross_open, sizeof(short)*4*cross_m);
 
   pknots = second.pknots;
 
-  bpair_pknot = second.bpair_pknot;
-
   return *this;
 }
 
-// checks if we can add it to the 'cross' vector (if it is compatible with )
-bool CrossOuter(vector<int> &cross, int point, short *str) {
-  if (cross.empty()) return true;
-  int left = cross.back();
-  int right = str[left];
-  if (point<left && str[point]>right) return true;
-  return false;
-}
-
-bool CrossInner(vector<int> &cross, int point, short *str) {
-  if (cross.empty()) return true;
-  int left = cross.back();
-  int right = str[left];
-  if (point>left && str[point]<right) return true;
-  return false;
-}
-
 // is the bpair viable?
 INS_FLAG Structure::ViableInsert(int left, int right, bool insert)
 {
@@ -950,53 +1053,19 @@ INS_FLAG Structure::ViableInsert(int left, int right, bool insert)
 
   INS_FLAG res = NO_INS;
 
-  // get crossings:
-  vector<set<int> > crossings;
-  vector<vector<int> > cross_tmp;
-  for (int i=left+1; i<right; i++) { // can be faster:
-    if (str[i] == 0) continue;
-    if (str[i] < left) { // ')'
-      int k=0;
-      if ((int)cross_tmp.size()<=k) cross_tmp.resize(k+1);
-      if ((int)crossings.size()<=k) crossings.resize(k+1);
-      while (!CrossOuter(cross_tmp[k], str[i], str)) {
-        k++;
-        if ((int)cross_tmp.size()<=k) cross_tmp.resize(k+1);
-        if ((int)crossings.size()<=k) crossings.resize(k+1);
-      }
-      cross_tmp[k].push_back(str[i]);
-      crossings[k].insert(str[i]);
-    } else if (str[i] > right) { // '('
-      int k=0;
-      if ((int)cross_tmp.size()<=k) cross_tmp.resize(k+1);
-      if ((int)crossings.size()<=k) crossings.resize(k+1);
-      while (!CrossInner(cross_tmp[k], i, str)) {
-        k++;
-        if ((int)cross_tmp.size()<=k) cross_tmp.resize(k+1);
-        if ((int)crossings.size()<=k) crossings.resize(k+1);
-      }
-      cross_tmp[k].push_back(i);
-      crossings[k].insert(i);
-    }
-  }
-  // sort the sets:
-  sort(crossings.begin(), crossings.end());
+  // get crossings (grouped into stacks):
+  CrossGroups crossings;
+  if (!CrossFind(left, right, crossings)) return NO_INS;
 
   // find if it crosses a pknot:
   Pseudoknot *cross_pk = NULL;
   int cross_index = -1;
   if (pknots.size()>0) {
-    for (unsigned int i=0; i<crossings.size(); i++) {
-      set<int>::iterator it = crossings[i].begin();
-
-
-
-      int index = bpair_pknot[*it];
+    for (int i=0; i<crossings.num; i++) {
+      int g = crossings.order[i];
+      if (!crossings.same_pk[g]) return NO_INS; // split the stack!
+      int index = Pknot_num(crossings.first[g]);
       Pseudoknot *pk_tmp = Pknot_index(index);
-      for (it++; it!=crossings[i].end(); it++) {
-        Pseudoknot *pk_now = Pknot_bpair(*it);
-        if (pk_tmp != pk_now) return NO_INS; // split the stack!
-      }
       if (pk_tmp != NULL) {
         if (cross_pk == NULL) {
           cross_pk = pk_tmp;
@@ -1016,10 +1085,11 @@ INS_FLAG Structure::ViableInsert(int left, int right, bool insert)
   if (cross_pk) {
     // check if we don't split the parts
     vector<int> numbers;
-    for (unsigned int i=0; i<crossings.size(); i++) {
+    for (int i=0; i<crossings.num; i++) {
+      int g = crossings.order[i];
       for (int j=0; j<cross_pk->size; j++) {
-        if (*cross_pk->parts[j].begin() == *crossings[i].begin()) {
-          if (cross_pk->parts[j] == crossings[i]) {
+        if (cross_pk->first[j] == crossings.first[g]) {
+          if (crossings.same_code[g] && crossings.code[g] == cross_index*4+j && crossings.count[g] == cross_pk->count[j]) {
             numbers.push_back(j);
             // stack is correct
             break;
@@ -1029,11 +1099,11 @@ INS_FLAG Structure::ViableInsert(int left, int right, bool insert)
         }
       }
       // each crossing we must find otherwise wrong.
-      if (numbers.size()==i) return NO_INS;
+      if ((int)numbers.size()==i) return NO_INS;
     }
 
     // now we have the numbers which we border (0-3), the rest should be checked if we can insert it in it
-    int inside = cross_pk->Inside(str, left, right);
+    int inside = PknotInside(cross_index, left, right);
     if (inside>=0) {
       // check if neighbourhood fits  // essentially numbers[x] == Imat(x, inside)
       int k=0;
@@ -1048,11 +1118,11 @@ INS_FLAG Structure::ViableInsert(int left, int right, bool insert)
       if (k != (int)numbers.size()) return NO_INS;
 
       // neighbourhood fits -> we can insert it in the parts[inside]
-      if (insert) cross_pk->parts[inside].insert(left);
+      if (insert) PartInsert(cross_index, inside, left);
       res = INSIDE_PK;
     } else {
       // we cannot insert it, but maybe we can change the type:
-      bool ci = cross_pk->CanInsert(left, numbers, insert);
+      bool ci = PknotCanInsert(cross_index, left, numbers, insert);
       if (ci) res = CHNG_PK;
       else res = NO_INS;
     }
@@ -1060,41 +1130,43 @@ INS_FLAG Structure::ViableInsert(int left, int right, bool insert)
   } else {
     // now we can insert it since we do not cross any pk.
     if (insert) {
-      switch (crossings.size()) {
+      switch (crossings.num) {
       case 0:
         break;
       case 1: {
         Pseudoknot pknot;
-        int cross_first = *crossings[0].begin();
-        int bpair = (left > cross_first)? 1:0;
-        pknot.parts[bpair].insert(left);
-        pknot.parts[bpair==0?1:0] = crossings[0];
+        int bpair = (left > crossings.first[0])? 1:0;
         pknot.imat[0][1] = true;
         pknot.size = 2;
         pknots.push_back(pknot);
         cross_index = pknots.size()-1;
-        for (set<int>::iterator it=crossings[0].begin(); it!=crossings[0].end(); it++) bpair_pknot[*it] = pknots.size()-1;
+        PartInsert(cross_index, bpair, left);
+        int part_of[1] = {bpair==0?1:0};
+        CrossGroups again;
+        CrossFind(left, right, again, cross_index, part_of);
         break;
         }
       case 2: {
         Pseudoknot pknot;
-        int bpair = (left > *crossings[0].begin())? ((left > *crossings[1].begin())? 2:1):0;
-        pknot.parts[bpair].insert(left);
-        pknot.parts[bpair<=0?1:0] = crossings[0];
-        pknot.parts[bpair<=1?2:1] = crossings[1];
+        int g0 = crossings.order[0], g1 = crossings.order[1];
+        int bpair = (left > crossings.first[g0])? ((left > crossings.first[g1])? 2:1):0;
         pknot.imat[0][1] = true;
         pknot.imat[1][2] = true;
         pknot.size = 3;
         pknots.push_back(pknot);
         cross_index = pknots.size()-1;
-        for (set<int>::iterator it=crossings[0].begin(); it!=crossings[0].end(); it++) bpair_pknot[*it] = pknots.size()-1;
-        for (set<int>::iterator it=crossings[1].begin(); it!=crossings[1].end(); it++) bpair_pknot[*it] = pknots.size()-1;
+        PartInsert(cross_index, bpair, left);
+        int part_of[2];
+        part_of[g0] = bpair<=0?1:0;
+        part_of[g1] = bpair<=1?2:1;
+        CrossGroups again;
+        CrossFind(left, right, again, cross_index, part_of);
         break;
         }
       default: assert(false);
       }
     }
-    switch (crossings.size()) {
+    switch (crossings.num) {
       case 0: res = REG_INS; break;
       case 1:
       case 2: res = CREATE_PK; break;
@@ -1102,9 +1174,10 @@ INS_FLAG Structure::ViableInsert(int left, int right, bool insert)
   }
 
   if (res != NO_INS && insert) {
-    bpair_pknot[left] = cross_index;
     str[left] = right;
     str[right] = left;
+    CrossUpdate(left);
+    CrossUpdate(right);
   }
   return res;
 }
@@ -1116,27 +1189,25 @@ bool Structure::Delete(int left)
 
   int right = str[left];
 
-  for (unsigned int i=0; i<pknots.size(); i++) {
-    if (pknots[i].Delete(left)) {
-      if (pknots[i].size == 1) {
-        for (int j=0; j<4; j++) {
-          for (set<int>::iterator it = pknots[i].parts[j].begin(); it!=pknots[i].parts[j].end(); it++) {
-            bpair_pknot[*it] = -1;
-          }
-        }
-        // erase the pknot and fix bpair_pknot
-        pknots.erase(pknots.begin()+i);
-        for (map<int, int>::iterator it=bpair_pknot.begin(); it!=bpair_pknot.end(); it++) {
-          if (it->second >= (int)i) it->second--;
-        }
+  int i = Pknot_num(left);
+  if (i>=0) {
+    PknotDelete(i, left);
+    if (pknots[i].size == 1) {
+      for (int j=0; j<4; j++) {
+        PartMove(i, j, -1, 0);
+      }
+      // erase the pknot and fix pk_part of the following ones
+      pknots.erase(pknots.begin()+i);
+      for (int k=1; k<=str[0]; k++) {
+        if (pk_part[k] >= (i+1)*4) pk_part[k] -= 4;
       }
-      break;
     }
   }
 
-  bpair_pknot.erase(left);
   str[left] = 0;
   str[right] = 0;
+  CrossUpdate(left);
+  CrossUpdate(right);
   return true;
 }
 
@@ -1171,11 +1242,149 @@ int Structure::UndoMove()
   return dif_en;
 }
 
+// closing bpair of the loop where position x lies (0 = exterior loop), structure must be pknot-free
+static int enclosing_bpair(short *str, int x)
+{
+  for (int y=x-1; y>0; y--) {
+    if (str[y]>y && str[y]>x) return y;
+    if (str[y]>0 && str[y]<y) y = str[y];   // skip the whole inner bpair
+  }
+  return 0;
+}
+
+// energy of one loop closed by c (0 = exterior loop) in pknot-free structure, same as loop_energy_rec would count it
+static int loop_energy_nested(short *str, short *s0, short *s1, int c)
+{
+  bool multiloop = (c != 0);
+  if (c == 0) return loop_energy_pk(0, str, s0, s1, P, multiloop);
+
+  int children = 0;
+  for (int k=c+1; k<str[c]; k++) {
+    if (str[k]>k) {
+      children++;
+      k = str[k];
+    }
+  }
+  if (children <= 1) return loop_energy(str, s0, s1, c);
+  return loop_energy_pk(c, str, s0, s1, P, multiloop);
+}
+
+// sum of energies of all loops that contain some of the positions (each loop counted once)
+static int loops_energy_nested(short *str, short *s0, short *s1, int *pos, int num)
+{
+  int loops[12];
+  int num_loops = 0;
+  for (int i=0; i<num; i++) {
+    int cand[2] = {enclosing_bpair(str, pos[i]), -1};
+    if (str[pos[i]]) cand[1] = min(pos[i], (int)str[pos[i]]);
+    for (int j=0; j<2; j++) {
+      if (cand[j] == -1) continue;
+      bool found = false;
+      for (int k=0; k<num_loops; k++) if (loops[k]==cand[j]) found = true;
+      if (!found) loops[num_loops++] = cand[j];
+    }
+  }
+
+  int energy = 0;
+  for (int k=0; k<num_loops; k++) energy += loop_energy_nested(str, s0, s1, loops[k]);
+  return energy;
+}
+
+// energy of the subtree of bpair c, which is not crossed by any other bpair - such a subtree is evaluated
+//  by loop_energy_rec on its own and its parent sees only the bpair c, whatever is inside
+static int region_energy_closed(short *str, short *s0, short *s1, int c, Helpers &hlps)
+{
+  hlps.Create(str[0]);
+  return loop_energy_rec(c, str, s0, s1, P, hlps).energy;
+}
+
+// energy of whole top-level components (pknots with all they contain) in a..b together with their share
+//  of the exterior loop, no bpair leaves or encloses a..b (as energy_of_struct_pk counts them)
+static int region_energy_ext(short *str, short *s0, short *s1, int a, int b, Helpers &hlps)
+{
+  hlps.Create(str[0]);
+  for (int i=a; i<=b; i++) hlps.str_type[i] = ROOT;
+
+  int energy = 0;
+  for (int i=a; i<=b; i++) {
+    if (str[i]>i && hlps.str_type[i]==ROOT) {
+      LE_ret ret = loop_energy_rec(i, str, s0, s1, P, hlps);
+      i = ret.ending;
+      energy += ret.energy;
+    }
+  }
+
+  // exterior loop - only stems in a..b (as in loop_energy_pk)
+  int alone_upto = a-1;
+  for (int i=a; i<=b; i++) {
+    if (str[i]>i && str[i]>alone_upto) {
+      energy += Ext_Loop(i, str[i], s0, P);
+      alone_upto = str[i];
+    }
+  }
+  return energy;
+}
+
+// bounds of the smallest independent region containing positions pos (str is after the move, before[] are their partners before it):
+//  returns true if it is the subtree of bpair a (b = str[a]) not crossed by anything,
+//  otherwise a..b are whole top-level components in both structures
+bool Structure::RegionBounds(int num, const int *pos, const short *before, int &a, int &b)
+{
+  a = b = pos[0];
+  for (int k=1; k<num; k++) {
+    a = min(a, pos[k]);
+    b = max(b, pos[k]);
+  }
+
+  // deepest enclosing bpair that is not in a pknot (the same in both structures, it is not touched)
+  for (int y=a-1; y>0; y--) {
+    if (str[y]>b && pk_part[y]<0) {
+      a = y;
+      b = str[y];
+      return true;
+    }
+  }
+
+  // close a..b (no bpair of either structure may leave it) and take whole components
+  int sa = a, sb = a-1;  // already checked
+  while (true) {
+    while (sa>a || sb<b) {
+      int k = (sa>a) ? --sa : ++sb;
+      int p1 = str[k], p2 = str[k];
+      for (int j=0; j<num; j++) if (pos[j]==k) p2 = before[j];
+      if (p1) { a = min(a, p1); b = max(b, p1); }
+      if (p2) { a = min(a, p2); b = max(b, p2); }
+    }
+    int y = a-1;
+    while (y>0 && str[y]<=b) y--;
+    if (y==0) break;
+    a = y;
+    b = str[y];
+  }
+  return false;
+}
+
 int Structure::MakeMove(const char *seq, short *s0, short *s1, int left, int right)
 {
+  PROF_COUNT(PROF_MOVE);
   undo_en = energy;
   bool change = false;
 
+  if (P == NULL) {
+    make_pair_matrix();
+    update_fold_params();
+    P = scale_parameters();
+  }
+
+  // positions touched by the move - if no pknot is involved, only their loops are reevaluated
+  int touched[3] = {abs(left), abs(right), 0};
+  int num_touched = 2;
+  if (left>0 && right>0 && (str[left]>0 || str[right]>0)) touched[num_touched++] = str[left]>0 ? str[left] : str[right];
+  short before[3];
+  for (int k=0; k<num_touched; k++) before[k] = str[touched[k]];
+  bool nested = pknots.empty();
+  int loops_before = nested ? loops_energy_nested(str, s0, s1, touched, num_touched) : 0;
+
   // switch?
   if (left>0 && right>0 && (str[left]>0 || str[right]>0)) {
     if (str[left]>0) {
@@ -1198,7 +1407,27 @@ int Structure::MakeMove(const char *seq, short *s0, short *s1, int left, int rig
     }
   }
 
-  if (change) energy = energy_of_struct_pk(seq, str, s0, s1, 0);
+  if (change) {
+    if (nested && pknots.empty()) {
+      energy += loops_energy_nested(str, s0, s1, touched, num_touched) - loops_before;
+    } else {
+      // pknot involved - reevaluate only the independent region around the move
+      int a, b;
+      bool closed = RegionBounds(num_touched, touched, before, a, b);
+      if (region_hlps == NULL) region_hlps = new Helpers(str[0]);
+      int region_after = closed ? region_energy_closed(str, s0, s1, a, *region_hlps) : region_energy_ext(str, s0, s1, a, b, *region_hlps);
+
+      // evaluate the old structure in place (energy functions need only the pair table)
+      short after[3];
+      for (int k=0; k<num_touched; k++) {
+        after[k] = str[touched[k]];
+        str[touched[k]] = before[k];
+      }
+      int region_before = closed ? region_energy_closed(str, s0, s1, a, *region_hlps) : region_energy_ext(str, s0, s1, a, b, *region_hlps);
+      for (int k=0; k<num_touched; k++) str[touched[k]] = after[k];
+      energy += region_after - region_before;
+    }
+  }
   return energy - undo_en;
 }
 
@@ -28,52 +28,45 @@ void pt_to_chars_pk(const short *str, char *dest);
 
 int Contains_PK(short *str);
 
-//debug
-float get_eos_time();
-
+// pseudoknot of up to 4 parts (stacks of crossing bpairs), plain data - cheap to copy
+//  members of the parts are marked in Structure::pk_part, here is only the span of their left ends
 class Pseudoknot
 {
 public:
   bool imat[4][4];
-  std::set<int> parts[4];
+  int first[4];   // lowest left end of a part
+  int last[4];    // highest left end of a part
+  int count[4];   // number of bpairs in a part (0 = empty part)
   int size;
 public:
-  // contains some bpair?
-  bool Contains(int left);
-
-  // crosses this bpair?
-  //bool Cross(short *str, int left, int right);
-
-  // can we insert it inside?
-  int Inside(short *str, int left, int right);
-
-  // can we insert it normally?
-  bool CanInsert(int left, std::vector<int> &numbers, bool insert = false);
-
-  // delete a bpair:
-  bool Delete(int left);
-
   inline bool Imat(int a, int b) {
     return a>b?imat[b][a]:imat[a][b];
   }
 
   // constructor
   Pseudoknot();
-  Pseudoknot(const Pseudoknot &pknot);
-
-  Pseudoknot &operator=(const Pseudoknot &pknot);
 };
 
 enum INS_FLAG {NO_INS, REG_INS, INSIDE_PK, CREATE_PK, CHNG_PK};
 
+struct CrossGroups;
+class Helpers;
+
 class Structure {
 
 public:
   // pknots:
   std::vector<Pseudoknot> pknots;
 
-  // map bpairs to pknots or nothing if the bpair is standard
-  std::map<int, int> bpair_pknot;
+  // for left ends of bpairs in pknots: pknot index*4 + part, -1 otherwise (pk_part[0] = length as in str)
+  short *pk_part;
+
+private:
+  // index of bpairs for crossing queries - two segment trees over positions (cross_m leaves each):
+  //  cross_open: max of right ends over left ends, cross_close: min of left ends over right ends
+  int cross_m;
+  short *cross_open;
+  short *cross_close;
 
 public:
   // old-school structure
@@ -88,6 +81,9 @@ private:
   int undo_r;
   int undo_en;
 
+  // scratch for region energies in MakeMove (allocated on the first move that touches a pknot, not copied)
+  Helpers *region_hlps;
+
 public:
   // constructor
   Structure(const char *seq, short *structure, short *s0, short *s1);
@@ -103,19 +99,44 @@ public:
     return &pknots[index];
   }
 
-  inline Pseudoknot *Pknot_bpair(int index) {
-    return Pknot_index(bpair_pknot[index]);
+  inline int Pknot_num(int left) {
+    return pk_part[left]<0 ? -1 : pk_part[left]/4;
+  }
+
+  inline Pseudoknot *Pknot_bpair(int left) {
+    return Pknot_index(Pknot_num(left));
   }
 
   bool const operator<(const Structure &second) const;
   bool const operator==(const Structure &second) const;
   Structure &operator=(const Structure &second);
 private:
+  // parts of pknots (members are found through pk_part)
+  void PartInsert(int pk, int part, int left);
+  void PartErase(int left);
+  void PartMove(int pk, int part, int new_pk, int new_part);
+  int PartNext(int pk, int part, int pos);  // lowest member > pos (0 if none)
+  int PartPrev(int pk, int part, int pos);  // highest member <= pos (0 if none)
+
+  // crossing index
+  void CrossInit(int length);
+  void CrossUpdate(int pos);
+  bool CrossCollect(int node, int nl, int nr, int lo, int hi, int thr, bool open, CrossGroups &groups, int pk = -1, const int *part_of = NULL);
+  bool CrossFind(int left, int right, CrossGroups &groups, int pk = -1, const int *part_of = NULL);
+
+  // pknot operations (can we insert it inside? normally? delete a bpair)
+  int PknotInside(int pk, int left, int right);
+  bool PknotCanInsert(int pk, int left, std::vector<int> &numbers, bool insert = false);
+  bool PknotDelete(int pk, int left);
+
   // is the bpair viable?
   INS_FLAG ViableInsert(int left, int right, bool insert = false);
   INS_FLAG Insert(int left, int right);
   INS_FLAG Shift(int left, int right);
   bool Delete(int left);
+
+  // smallest independent region around the positions changed by a move
+  bool RegionBounds(int num, const int *pos, const short *before, int &a, int &b);
 public:
   // do a move
   int MakeMove(const char *seq, short *s0, short *s1, int left, int right);
@@ -0,0 +1,66 @@
+#ifdef PROFILE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+#include "profile.h"
+
+#define PROF_MAX_THREADS 64
+
+static const char prof_name[PROF_NUM][20] = {"energy_of_struct", "move_delta", "flood_expand", "findpath_expand", "saddle_search"};
+
+// one cache line per thread, so the counting threads do not share it
+struct prof_slot {
+  long long count[PROF_NUM];
+  double time[PROF_NUM];
+} __attribute__((aligned(64)));
+
+static prof_slot prof_slots[PROF_MAX_THREADS];
+
+void prof_add(int counter, double time)
+{
+#ifdef _OPENMP
+  int thread = omp_get_thread_num() % PROF_MAX_THREADS;
+#else
+  int thread = 0;
+#endif
+  prof_slots[thread].count[counter]++;
+  prof_slots[thread].time[counter] += time;
+}
+
+double prof_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+long long prof_count(int counter)
+{
+  long long count = 0;
+  for (int t=0; t<PROF_MAX_THREADS; t++) count += prof_slots[t].count[counter];
+  return count;
+}
+
+static void prof_report()
+{
+  fprintf(stderr, "Profile:            %14s %12s %12s\n", "count", "time(s)", "avg(us)");
+  for (int c=0; c<PROF_NUM; c++) {
+    long long count = prof_count(c);
+    double time = 0.0;
+    for (int t=0; t<PROF_MAX_THREADS; t++) time += prof_slots[t].time[c];
+    fprintf(stderr, "  %-17s %14lld %12.3f %12.3f\n", prof_name[c], count, time, count ? time/count*1e6 : 0.0);
+  }
+}
+
+void prof_init()
+{
+  atexit(prof_report);
+}
+
+#endif
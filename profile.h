@@ -0,0 +1,42 @@
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+// opt-in counters and timers of the inner loops, compiled in only with -DPROFILE (make PROFILE=1)
+//  without it all PROF_* macros are empty, with it a summary is printed to stderr at exit
+
+enum prof_counter {PROF_EOS, PROF_MOVE, PROF_FLOOD, PROF_FINDPATH, PROF_SADDLE, PROF_NUM};
+
+#ifdef PROFILE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// add one event (and its duration in seconds) to the counter (thread-safe)
+void prof_add(int counter, double time);
+// monotonic wall time in seconds
+double prof_now();
+// register the summary at exit
+void prof_init();
+// events of the counter so far (all threads)
+long long prof_count(int counter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define PROF_INIT()       prof_init()
+#define PROF_COUNT(c)     prof_add((c), 0.0)
+#define PROF_START(t)     double t = prof_now()
+#define PROF_STOP(c, t)   prof_add((c), prof_now()-(t))
+
+#else
+
+#define PROF_INIT()
+#define PROF_COUNT(c)
+#define PROF_START(t)
+#define PROF_STOP(c, t)
+
+#endif
+
+#endif
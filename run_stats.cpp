@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+#include "run_stats.h"
+
+using namespace std;
+
+static const char phase_name[ST_NUM][10] = {"init", "sampling", "shallow", "flood", "findpath", "tree", "output"};
+
+// some singleton objects
+RunStats Stats;
+
+static double wall_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static double cpu_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+RunStats::RunStats()
+{
+  on = false;
+  for (int i=0; i<ST_NUM; i++) wall[i] = cpu[i] = 0.0;
+  phase = ST_INIT;
+  phase_wall = wall_now();
+  phase_cpu = cpu_now();
+
+  seq_len = 0;
+  samples = unique = 0;
+  not_canonical = minima = minima_out = 0;
+  memset(walk_len, 0, sizeof(walk_len));
+  flood_tried = flood_escaped = 0;
+  findpath_pairs = findpath_known = 0;
+  hash_size = hash_buckets = 0;
+  hash_max_load = 0.0;
+}
+
+void RunStats::Phase(int next)
+{
+  double w = wall_now();
+  double c = cpu_now();
+  if (phase < ST_NUM) {
+    wall[phase] += w - phase_wall;
+    cpu[phase] += c - phase_cpu;
+  }
+  phase = next;
+  phase_wall = w;
+  phase_cpu = c;
+}
+
+void RunStats::Walk(int length)
+{
+  if (length > STATS_WALK_MAX) length = STATS_WALK_MAX;
+  #pragma omp atomic
+  walk_len[length]++;
+}
+
+void RunStats::Flood(int size, bool escaped)
+{
+  flood_tried++;
+  if (escaped) flood_escaped++;
+  flood_size[size]++;
+}
+
+bool RunStats::WriteJson(const char *filename)
+{
+  FILE *f = fopen(filename, "w");
+  if (f == NULL) {
+    fprintf(stderr, "ERROR: couldn't open file \"%s\" for statistics!\n", filename);
+    return false;
+  }
+
+  int threads = 1;
+#ifdef _OPENMP
+  threads = omp_get_max_threads();
+#endif
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+
+  double wall_total = 0.0, cpu_total = 0.0;
+  for (int i=0; i<ST_NUM; i++) {
+    wall_total += wall[i];
+    cpu_total += cpu[i];
+  }
+
+  fprintf(f, "{\n");
+  fprintf(f, "  \"sequence_length\": %d,\n", seq_len);
+  fprintf(f, "  \"threads\": %d,\n", threads);
+  fprintf(f, "  \"phases\": {\n");
+  for (int i=0; i<ST_NUM; i++) {
+    fprintf(f, "    \"%s\": {\"wall\": %.6f, \"cpu\": %.6f},\n", phase_name[i], wall[i], cpu[i]);
+  }
+  fprintf(f, "    \"total\": {\"wall\": %.6f, \"cpu\": %.6f}\n", wall_total, cpu_total);
+  fprintf(f, "  },\n");
+  fprintf(f, "  \"samples\": %lld,\n", samples);
+  fprintf(f, "  \"unique_structures\": %lld,\n", unique);
+  fprintf(f, "  \"lone_pair_structures\": %d,\n", not_canonical);
+  fprintf(f, "  \"minima_found\": %d,\n", minima);
+  fprintf(f, "  \"minima_output\": %d,\n", minima_out);
+
+  // histograms: only nonzero bins, "length": count
+  fprintf(f, "  \"walk_lengths\": {");
+  bool first = true;
+  for (int i=0; i<=STATS_WALK_MAX; i++) {
+    if (walk_len[i] == 0) continue;
+    fprintf(f, "%s\"%d\": %lld", (first ? "" : ", "), i, walk_len[i]);
+    first = false;
+  }
+  fprintf(f, "},\n");
+
+  fprintf(f, "  \"floods\": {\"tried\": %d, \"escaped\": %d, \"sizes\": {", flood_tried, flood_escaped);
+  first = true;
+  for (map<int, long long>::iterator it=flood_size.begin(); it!=flood_size.end(); it++) {
+    fprintf(f, "%s\"%d\": %lld", (first ? "" : ", "), it->first, it->second);
+    first = false;
+  }
+  fprintf(f, "}},\n");
+
+  fprintf(f, "  \"findpath\": {\"pairs\": %lld, \"known\": %lld},\n", findpath_pairs, findpath_known);
+  fprintf(f, "  \"hash\": {\"size\": %lld, \"buckets\": %lld, \"load_factor\": %.6f, \"max_load_factor\": %.6f},\n",
+          hash_size, hash_buckets, (hash_buckets ? hash_size/(double)hash_buckets : 0.0), hash_max_load);
+  fprintf(f, "  \"peak_rss_kb\": %ld\n", ru.ru_maxrss);
+  fprintf(f, "}\n");
+
+  bool ok = !ferror(f);
+  ok = (fclose(f) == 0) && ok;
+  if (!ok) fprintf(stderr, "ERROR: couldn't write statistics \"%s\"!\n", filename);
+  return ok;
+}
@@ -0,0 +1,59 @@
+#ifndef __RUN_STATS_H
+#define __RUN_STATS_H
+
+#include <map>
+
+// statistics of a run for --stats-json (for tracking performance across versions)
+//  phases are timed by wall clock and by CPU time of the whole process (all threads)
+
+enum STATS_PHASE {ST_INIT, ST_SAMPLING, ST_SHALLOW, ST_FLOOD, ST_FINDPATH, ST_TREE, ST_OUTPUT, ST_NUM};
+
+#define STATS_WALK_MAX 1024  // longer walks are counted together
+
+class RunStats {
+public:
+  bool on;
+
+  // times of phases
+  double wall[ST_NUM];
+  double cpu[ST_NUM];
+  int phase;
+  double phase_wall;
+  double phase_cpu;
+
+  // counts
+  int seq_len;
+  long long samples;        // structures read
+  long long unique;         // unique structures (walked)
+  int not_canonical;        // structures with lone pairs (skipped with --noLP)
+  int minima;               // minima found
+  int minima_out;           // minima after --min-num and --minh
+  long long walk_len[STATS_WALK_MAX+1];  // histogram of gradient walk lengths (number of moves, without pseudoknotted walks)
+  std::map<int, long long> flood_size;   // histogram of flood sizes (number of expanded structures)
+  int flood_tried;
+  int flood_escaped;        // floods that found the saddle
+  long long findpath_pairs; // findpath runs
+  long long findpath_known; // pairs with saddle known before (--resume, --merge)
+
+  // hash of walked structures (at the end of sampling)
+  long long hash_size;
+  long long hash_buckets;
+  double hash_max_load;
+
+public:
+  RunStats();
+
+  // end the current phase and start the next one (ST_NUM = end of run)
+  void Phase(int next);
+  // one gradient walk (thread-safe)
+  void Walk(int length);
+  // one flood (not thread-safe - floods are serial)
+  void Flood(int size, bool escaped);
+
+  // write statistics as JSON, returns false on error
+  bool WriteJson(const char *filename);
+};
+
+extern RunStats Stats;
+
+#endif
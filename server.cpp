@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <ctype.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <string>
+#include <map>
+#include <vector>
+#include <unordered_map>
+
+extern "C" {
+  #include "fold.h"
+  #include "utils.h"
+}
+
+#include "server.h"
+#include "librnalocmin.h"
+#include "RNAlocmin.h"
+
+using namespace std;
+
+// protocol (one command per line, answer is flushed after each command):
+//  SEQ <sequence>          select sequence (contexts are kept for all sequences seen) -> "OK <length> <number of known minima>"
+//  DESCEND <str> [<str>..] local minima of structures -> one line "<index> <minimum> <energy>" per structure
+//  ENERGY <str> [<str>..]  energies of structures -> one line "<energy>" per structure
+//  SADDLE <a> <b>          saddle height between two structures or minima (given by index) -> "<energy>"
+//  MINIMA                  known minima -> "OK <n>" and n lines "<index> <minimum> <energy> <hits>"
+//  RESET                   forget walks and minima of the current sequence -> "OK"
+//  QUIT                    close connection (end of input does the same)
+//  SHUTDOWN                stop the server
+// a failed query is answered with a line "ERR <reason>", energies are in kcal/mol
+
+// all we know about one sequence
+struct ServerSeq {
+  LMContext ctx;
+  int len;
+
+  unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> walks;   // structure -> its minimum (minimum memory belongs to minima_list)
+  unordered_map<struct_en, int, hash_fncts, hash_eq> minima;        // minimum -> its index
+  vector<struct_en> minima_list;
+  vector<int> hits;
+  map<pair<string, string>, int> saddles;
+
+  ServerSeq(const char *seq):ctx(seq, Opt.Walk()) {
+    len = strlen(seq);
+  }
+
+  ~ServerSeq() {
+    Reset();
+  }
+
+  void Reset() {
+    for (unordered_map<struct_en, gw_struct, hash_fncts, hash_eq>::iterator it=walks.begin(); it!=walks.end(); it++) {
+      free(it->first.structure);
+    }
+    walks.clear();
+    minima.clear();
+    for (unsigned int i=0; i<minima_list.size(); i++) free(minima_list[i].structure);
+    minima_list.clear();
+    hits.clear();
+    saddles.clear();
+  }
+
+  // index of minimum lm (takes its structure), adds it if new
+  int AddMinimum(struct_en &lm) {
+    unordered_map<struct_en, int, hash_fncts, hash_eq>::iterator it = minima.find(lm);
+    if (it != minima.end()) {
+      free(lm.structure);
+      lm = minima_list[it->second];
+      return it->second;
+    }
+    int index = minima_list.size();
+    minima_list.push_back(lm);
+    hits.push_back(0);
+    minima[lm] = index;
+    return index;
+  }
+};
+
+// parse a structure in dot-bracket, NULL (and reason) if it is not a structure of the sequence
+short *server_structure(ServerSeq &ss, const char *p, const char *&err)
+{
+  if ((int)strlen(p) != ss.len) {
+    err = "unequal lengths of structure and sequence";
+    return NULL;
+  }
+  // the pair table parsers do not check the brackets (make_pair_table exits, make_pair_table_PK reads an empty stack)
+  const char *open = (Opt.pknots ? "([{<" : "(");
+  const char *close = (Opt.pknots ? ")]}>" : ")");
+  int depth[4] = {0, 0, 0, 0};
+  for (int i=0; p[i]; i++) {
+    if (p[i] == '.') continue;
+    const char *o = strchr(open, p[i]);
+    const char *c = strchr(close, p[i]);
+    if (!o && !c) {
+      err = (strchr("[]{}<>", p[i]) ? "pseudoknots not allowed (run with -k)" : "not a structure");
+      return NULL;
+    }
+    if (o) depth[o-open]++;
+    else if (--depth[c-close] < 0) break;
+  }
+  for (int k=0; k<4; k++) {
+    if (depth[k]) {
+      err = "unbalanced brackets";
+      return NULL;
+    }
+  }
+  return Opt.pknots? make_pair_table_PK(p):make_pair_table(p);
+}
+
+// DESCEND: structures not walked yet are walked at once (in parallel), the rest is answered from the walk cache
+void server_descend(ServerSeq &ss, vector<char*> &args, FILE *out)
+{
+  int num = args.size();
+  vector<int> result(num, -1);
+  vector<const char*> errs(num, (const char*)NULL);
+
+  // look up the cache
+  vector<struct_en> todo;
+  vector<int> todo_pos;
+  for (int i=0; i<num; i++) {
+    struct_en str;
+    str.structure = server_structure(ss, args[i], errs[i]);
+    if (!str.structure) continue;
+    unordered_map<struct_en, gw_struct, hash_fncts, hash_eq>::iterator it = ss.walks.find(str);
+    if (it != ss.walks.end()) {
+      result[i] = ss.minima[it->second.he];
+      free(str.structure);
+    } else {
+      str.energy = INT_MAX;
+      todo.push_back(str);
+      todo_pos.push_back(i);
+    }
+  }
+
+  // walk the rest
+  if (!todo.empty()) {
+    vector<struct_en> lms;
+    lm_descend_all(ss.ctx, todo, lms);
+    for (unsigned int k=0; k<todo.size(); k++) {
+      int i = todo_pos[k];
+      if (lms[k].structure == NULL) {
+        errs[i] = (Opt.pknots && (!Opt.noLP || find_lone_pair(todo[k].structure)==-1) ? "unsupported pseudoknot" : "lone pair");
+        free(todo[k].structure);
+        continue;
+      }
+      // the same structure can be twice in one query
+      unordered_map<struct_en, gw_struct, hash_fncts, hash_eq>::iterator it = ss.walks.find(todo[k]);
+      if (it != ss.walks.end()) {
+        result[i] = ss.minima[it->second.he];
+        free(todo[k].structure);
+        free(lms[k].structure);
+        continue;
+      }
+      result[i] = ss.AddMinimum(lms[k]);
+      gw_struct gw;
+      gw.he = ss.minima_list[result[i]];
+      ss.walks[todo[k]] = gw;
+    }
+  }
+
+  // answer
+  for (int i=0; i<num; i++) {
+    if (result[i] == -1) {
+      fprintf(out, "ERR %s\n", errs[i]);
+      continue;
+    }
+    ss.hits[result[i]]++;
+    struct_en &lm = ss.minima_list[result[i]];
+    fprintf(out, "%d %s %6.2f\n", result[i], pt_to_str_pk(lm.structure).c_str(), lm.energy/100.0);
+  }
+}
+
+// structure of SADDLE argument - either dot-bracket or index of a known minimum
+bool server_saddle_arg(ServerSeq &ss, const char *p, string &res, const char *&err)
+{
+  if (isdigit(p[0])) {
+    unsigned int index = atoi(p);
+    if (index >= ss.minima_list.size()) {
+      err = "no such minimum";
+      return false;
+    }
+    res = pt_to_str_pk(ss.minima_list[index].structure);
+    return true;
+  }
+  short *pt = server_structure(ss, p, err);
+  if (!pt) return false;
+  free(pt);
+  res = p;
+  return true;
+}
+
+// serve one client, returns false on SHUTDOWN
+bool server_serve(map<string, ServerSeq*> &seqs, ServerSeq *&cur, FILE *in, FILE *out, int depth)
+{
+  char *line;
+  while ((line = my_getline(in)) != NULL) {
+    clock_t clck1 = clock();
+
+    // split
+    vector<char*> args;
+    for (char *p = strtok(line, " \t\r"); p!=NULL; p = strtok(NULL, " \t\r")) args.push_back(p);
+    if (args.empty()) {
+      free(line);
+      continue;
+    }
+    string cmd(args[0]);
+    for (unsigned int i=0; i<cmd.size(); i++) cmd[i] = toupper(cmd[i]);
+    args.erase(args.begin());
+
+    bool stop = false, shutdown = false;
+    if (cmd == "QUIT") {
+      stop = true;
+    } else if (cmd == "SHUTDOWN") {
+      stop = shutdown = true;
+    } else if (cmd == "SEQ") {
+      if (args.size() != 1) fprintf(out, "ERR SEQ needs one sequence\n");
+      else {
+        string seq(args[0]);
+        for (unsigned int i=0; i<seq.size(); i++) {
+          seq[i] = toupper(seq[i]);
+          if (seq[i]=='T') seq[i]='U';
+        }
+        if (seq.find_first_not_of("ACGU") != string::npos) fprintf(out, "ERR not a sequence\n");
+        else {
+          map<string, ServerSeq*>::iterator it = seqs.find(seq);
+          if (it == seqs.end()) it = seqs.insert(make_pair(seq, new ServerSeq(seq.c_str()))).first;
+          cur = it->second;
+          fprintf(out, "OK %d %d\n", cur->len, (int)cur->minima_list.size());
+        }
+      }
+    } else if (cur == NULL) {
+      fprintf(out, "ERR no sequence selected\n");
+    } else if (cmd == "DESCEND") {
+      server_descend(*cur, args, out);
+    } else if (cmd == "ENERGY") {
+      for (unsigned int i=0; i<args.size(); i++) {
+        const char *err;
+        short *pt = server_structure(*cur, args[i], err);
+        if (!pt) fprintf(out, "ERR %s\n", err);
+        else {
+          fprintf(out, "%6.2f\n", lm_energy(cur->ctx, pt)/100.0);
+          free(pt);
+        }
+      }
+    } else if (cmd == "SADDLE") {
+      string str1, str2;
+      const char *err = "SADDLE needs two structures";
+      if (args.size() == 2 && server_saddle_arg(*cur, args[0], str1, err) && server_saddle_arg(*cur, args[1], str2, err)) {
+        // saddle is symmetric
+        if (str2 < str1) swap(str1, str2);
+        map<pair<string, string>, int>::iterator it = cur->saddles.find(make_pair(str1, str2));
+        if (it == cur->saddles.end()) {
+          int saddle = lm_saddle(cur->ctx, str1.c_str(), str2.c_str(), depth);
+          it = cur->saddles.insert(make_pair(make_pair(str1, str2), saddle)).first;
+        }
+        fprintf(out, "%6.2f\n", it->second/100.0);
+      } else fprintf(out, "ERR %s\n", err);
+    } else if (cmd == "MINIMA") {
+      fprintf(out, "OK %d\n", (int)cur->minima_list.size());
+      for (unsigned int i=0; i<cur->minima_list.size(); i++) {
+        fprintf(out, "%d %s %6.2f %d\n", i, pt_to_str_pk(cur->minima_list[i].structure).c_str(), cur->minima_list[i].energy/100.0, cur->hits[i]);
+      }
+    } else if (cmd == "RESET") {
+      cur->Reset();
+      fprintf(out, "OK\n");
+    } else {
+      fprintf(out, "ERR unknown command %s\n", cmd.c_str());
+    }
+    fflush(out);
+
+    if (Opt.verbose_lvl>0) fprintf(stderr, "server: %s %.6f secs.\n", cmd.c_str(), (clock() - clck1)/(double)CLOCKS_PER_SEC);
+    free(line);
+    if (stop) return !shutdown;
+  }
+  return true;
+}
+
+int server_run(gengetopt_args_info &args_info, char *seq)
+{
+  map<string, ServerSeq*> seqs;
+  ServerSeq *cur = NULL;
+  if (seq) {
+    cur = new ServerSeq(seq);
+    seqs[seq] = cur;
+  }
+
+  int ret = 0;
+  if (!args_info.server_socket_given) {
+    server_serve(seqs, cur, stdin, stdout, args_info.depth_arg);
+  } else {
+    // listen on a Unix socket, clients are served one after another
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(args_info.server_socket_arg) >= sizeof(addr.sun_path)) {
+      fprintf(stderr, "ERROR: Socket path \"%s\" is too long.\n", args_info.server_socket_arg);
+      return EXIT_FAILURE;
+    }
+    strcpy(addr.sun_path, args_info.server_socket_arg);
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(args_info.server_socket_arg);
+    if (sock == -1 || bind(sock, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(sock, 16) == -1) {
+      fprintf(stderr, "ERROR: Cannot listen on socket \"%s\".\n", args_info.server_socket_arg);
+      if (sock != -1) close(sock);
+      return EXIT_FAILURE;
+    }
+    // a client leaving early must not kill us
+    signal(SIGPIPE, SIG_IGN);
+    if (Opt.verbose_lvl>0) fprintf(stderr, "server: listening on %s\n", args_info.server_socket_arg);
+
+    bool run = true;
+    while (run) {
+      int fd = accept(sock, NULL, NULL);
+      if (fd == -1) {
+        fprintf(stderr, "ERROR: Cannot accept connection on socket \"%s\".\n", args_info.server_socket_arg);
+        ret = EXIT_FAILURE;
+        break;
+      }
+      FILE *in = fdopen(fd, "r");
+      FILE *out = fdopen(dup(fd), "w");
+      run = server_serve(seqs, cur, in, out, args_info.depth_arg);
+      fclose(in);
+      fclose(out);
+    }
+    close(sock);
+    unlink(args_info.server_socket_arg);
+  }
+
+  for (map<string, ServerSeq*>::iterator it=seqs.begin(); it!=seqs.end(); it++) delete it->second;
+  return ret;
+}
@@ -0,0 +1,14 @@
+#ifndef __SERVER_H
+#define __SERVER_H
+
+extern "C" {
+  #include "RNAlocmin_cmdline.h"
+}
+
+// server mode (--server): answers descent and saddle queries from a line protocol on stdin or a Unix socket (--server-socket),
+//  walks and found minima are kept for each sequence between the queries
+//  seq (can be NULL) is the sequence selected at start
+// returns exit status
+int server_run(gengetopt_args_info &args_info, char *seq);
+
+#endif
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <map>
+#include <vector>
+#include <unordered_map>
+
+#include "shard.h"
+#include "checkpoint.h"
+#include "RNAlocmin.h"
+
+using namespace std;
+
+bool shard_write(const char *filename, const char *seq, map<struct_en, int, comps_entries> &output, unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> *structs)
+{
+  FILE *f = fopen(filename, "wb");
+  if (f == NULL) {
+    fprintf(stderr, "ERROR: couldn't open file \"%s\" for shard!\n", filename);
+    return false;
+  }
+  setvbuf(f, NULL, _IOFBF, 1<<20);
+
+  int version = SHARD_VERSION;
+  int len = strlen(seq);
+  fwrite(SHARD_MAGIC, 1, 8, f);
+  fwrite(&version, sizeof(int), 1, f);
+  fwrite(&len, sizeof(int), 1, f);
+  fwrite(seq, 1, len, f);
+
+  // minima
+  int num = output.size();
+  fwrite(&num, sizeof(int), 1, f);
+  map<struct_en, int, comps_entries> index_of;
+  for (map<struct_en, int, comps_entries>::iterator it=output.begin(); it!=output.end(); it++) {
+    write_struct(f, it->first, it->second);
+    index_of.insert(index_of.end(), make_pair(it->first, (int)index_of.size()));
+  }
+
+  // walked structures
+  num = (structs ? structs->size() : 0);
+  fwrite(&num, sizeof(int), 1, f);
+  if (structs) {
+    for (unordered_map<struct_en, gw_struct, hash_fncts, hash_eq>::iterator it=structs->begin(); it!=structs->end(); it++) {
+      write_struct(f, it->first, it->second.count);
+      const struct_en &he = it->second.he;
+      // minima evicted by --bounded here are above all minima in output (their structure is freed),
+      //  evicted in a merged shard have no structure (and may be below minima kept by other shards)
+      int index = -1;
+      if (he.structure != NULL && !output.empty() && he.energy <= output.rbegin()->first.energy) {
+        map<struct_en, int, comps_entries>::iterator it_o = index_of.find(he);
+        if (it_o != index_of.end()) index = it_o->second;
+      }
+      fwrite(&index, sizeof(int), 1, f);
+      fwrite(&he.energy, sizeof(int), 1, f);
+    }
+  }
+
+  bool ok = !ferror(f);
+  ok = (fclose(f) == 0) && ok;
+  if (!ok) fprintf(stderr, "ERROR: couldn't write shard \"%s\"!\n", filename);
+  return ok;
+}
+
+bool shard_append_saddles(const char *filename, int num, float *energy_barr, bool *findpath_barr, vector<int> &index)
+{
+  FILE *f = fopen(filename, "ab");
+  if (f == NULL) {
+    fprintf(stderr, "ERROR: couldn't open file \"%s\" for shard saddles!\n", filename);
+    return false;
+  }
+  setvbuf(f, NULL, _IOFBF, 1<<20);
+
+  int count = 0;
+  for (int i=0; i<num; i++) {
+    for (int j=i+1; j<num; j++) {
+      if (energy_barr[(size_t)i*num+j]<RATES_NO_SADDLE) count++;
+    }
+  }
+  fwrite(&count, sizeof(int), 1, f);
+  for (int i=0; i<num; i++) {
+    for (int j=i+1; j<num; j++) {
+      size_t ij = (size_t)i*num+j;
+      if (energy_barr[ij]>=RATES_NO_SADDLE) continue;
+      char fp = findpath_barr[ij];
+      fwrite(&index[i], sizeof(int), 1, f);
+      fwrite(&index[j], sizeof(int), 1, f);
+      fwrite(&energy_barr[ij], sizeof(float), 1, f);
+      fwrite(&fp, sizeof(char), 1, f);
+    }
+  }
+
+  bool ok = !ferror(f);
+  ok = (fclose(f) == 0) && ok;
+  if (!ok) fprintf(stderr, "ERROR: couldn't write shard \"%s\"!\n", filename);
+  return ok;
+}
+
+// read one shard into the merged data, returns false on error
+static bool shard_read(const char *filename, string &seq, map<struct_en, int, comps_entries> &output, unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> *structs,
+                       map<pair<const short*, const short*>, pair<float, bool> > &saddles)
+{
+  FILE *f = fopen(filename, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "ERROR: Cannot open shard \"%s\".\n", filename);
+    return false;
+  }
+  setvbuf(f, NULL, _IOFBF, 1<<20);
+
+  // header
+  char magic[8];
+  int version, len;
+  if (fread(magic, 1, 8, f) != 8 || memcmp(magic, SHARD_MAGIC, 8) != 0 ||
+      fread(&version, sizeof(int), 1, f) != 1 || version != SHARD_VERSION ||
+      fread(&len, sizeof(int), 1, f) != 1 || len <= 0) {
+    fprintf(stderr, "ERROR: \"%s\" is not a shard of this version.\n", filename);
+    fclose(f);
+    return false;
+  }
+  string s(len, ' ');
+  bool ok = fread(&s[0], 1, len, f) == (size_t)len;
+  if (ok && seq.empty()) seq = s;
+  if (ok && s != seq) {
+    fprintf(stderr, "ERROR: Shard \"%s\" is for another sequence.\n", filename);
+    fclose(f);
+    return false;
+  }
+
+  // minima (local indices point to merged ones)
+  int num = 0, hits;
+  ok = ok && fread(&num, sizeof(int), 1, f) == 1 && num >= 0;
+  vector<struct_en> local;
+  for (int i=0; ok && i<num; i++) {
+    struct_en he;
+    ok = read_struct(f, len, he, hits);
+    if (!ok) break;
+    map<struct_en, int, comps_entries>::iterator it = output.find(he);
+    if (it != output.end()) {
+      it->second += hits;
+      free(he.structure);
+      local.push_back(it->first);
+    } else {
+      output.insert(make_pair(he, hits));
+      local.push_back(he);
+    }
+  }
+
+  // walked structures
+  int num_s = 0;
+  ok = ok && fread(&num_s, sizeof(int), 1, f) == 1 && num_s >= 0;
+  for (int i=0; ok && i<num_s; i++) {
+    struct_en he;
+    gw_struct gw;
+    int index;
+    ok = read_struct(f, len, he, gw.count) && fread(&index, sizeof(int), 1, f) == 1 && fread(&gw.he.energy, sizeof(int), 1, f) == 1 && index < num;
+    if (!ok || !structs) {
+      if (he.structure) free(he.structure);
+      continue;
+    }
+    unordered_map<struct_en, gw_struct, hash_fncts, hash_eq>::iterator it = structs->find(he);
+    if (it != structs->end()) {
+      it->second.count += gw.count;
+      // its minimum was evicted in the shard it came from first
+      if (it->second.he.structure == NULL && index >= 0) it->second.he = local[index];
+      free(he.structure);
+    } else {
+      if (index >= 0) gw.he = local[index];
+      (*structs)[he] = gw;
+    }
+  }
+
+  // saddles (only if computed)
+  int num_sd = 0;
+  if (ok && fread(&num_sd, sizeof(int), 1, f) == 1) {
+    for (int k=0; ok && k<num_sd; k++) {
+      int i, j;
+      float saddle;
+      char fp;
+      ok = fread(&i, sizeof(int), 1, f) == 1 && fread(&j, sizeof(int), 1, f) == 1 && fread(&saddle, sizeof(float), 1, f) == 1 && fread(&fp, sizeof(char), 1, f) == 1
+           && i >= 0 && i < num && j >= 0 && j < num && i != j;
+      if (!ok) break;
+      if (comps_entries()(local[j], local[i])) swap(i, j);
+      pair<const short*, const short*> key(local[i].structure, local[j].structure);
+      map<pair<const short*, const short*>, pair<float, bool> >::iterator it = saddles.find(key);
+      if (it == saddles.end() || saddle < it->second.first) saddles[key] = make_pair(saddle, (bool)fp);
+    }
+  }
+  fclose(f);
+
+  if (!ok) fprintf(stderr, "ERROR: Shard \"%s\" is damaged.\n", filename);
+  return ok;
+}
+
+char *shard_merge(int count, char **filenames, map<struct_en, int, comps_entries> &output, unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> *structs, vector<shard_saddle> &saddles)
+{
+  string seq;
+  map<pair<const short*, const short*>, pair<float, bool> > sd;
+  for (int i=0; i<count; i++) {
+    if (!shard_read(filenames[i], seq, output, structs, sd)) return NULL;
+  }
+
+  // saddles by index in output
+  map<const short*, int> index_of;
+  for (map<struct_en, int, comps_entries>::iterator it=output.begin(); it!=output.end(); it++) {
+    index_of.insert(make_pair(it->first.structure, (int)index_of.size()));
+  }
+  for (map<pair<const short*, const short*>, pair<float, bool> >::iterator it=sd.begin(); it!=sd.end(); it++) {
+    shard_saddle s;
+    s.i = index_of[it->first.first];
+    s.j = index_of[it->first.second];
+    s.saddle = it->second.first;
+    s.findpath = it->second.second;
+    saddles.push_back(s);
+  }
+
+  return strdup(seq.c_str());
+}
@@ -0,0 +1,37 @@
+#ifndef __SHARD_H
+#define __SHARD_H
+
+#include <map>
+#include <vector>
+#include <unordered_map>
+
+#include "hash_util.h"
+
+// mergeable summary of a run on a part of the samples (--shard-out, --merge), native endianness:
+//   magic (8 chars), version (int), sequence length (int), sequence (chars)
+//   number of minima (int), minima (pair table, energy, hits) - sorted as in output, their order gives indices
+//   number of walked structures (int, 0 without --shard-assign), walked structures (pair table, energy, times sampled, index of minimum or -1 if evicted, energy of minimum)
+//   number of saddles (int, missing if saddles were not computed), saddles (index, index, saddle in kcal/mol (float), found by findpath (char))
+#define SHARD_MAGIC "RLMSHARD"
+#define SHARD_VERSION 1
+
+// saddle between minima i and j (indices into sorted minima)
+struct shard_saddle {
+  int i;
+  int j;
+  float saddle;
+  bool findpath;
+};
+
+// write minima with hits (and walked structures with their minima if structs is not NULL), returns false on error
+bool shard_write(const char *filename, const char *seq, std::map<struct_en, int, comps_entries> &output, std::unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> *structs);
+
+// append saddles (energy_barr and findpath_barr are num*num), index[i] is the index of minimum i in the written minima, returns false on error
+bool shard_append_saddles(const char *filename, int num, float *energy_barr, bool *findpath_barr, std::vector<int> &index);
+
+// read shards and merge them: hits of minima are summed into output, times sampled into structs (if not NULL),
+//  saddles (the lowest one if more shards have it) are indexed by minima in output
+// returns sequence (to be freed) or NULL on error
+char *shard_merge(int count, char **filenames, std::map<struct_en, int, comps_entries> &output, std::unordered_map<struct_en, gw_struct, hash_fncts, hash_eq> *structs, std::vector<shard_saddle> &saddles);
+
+#endif
@@ -22,11 +22,30 @@ typedef struct link {
   struct link *next;
 } linkT;
 
+/* union-find over chains/subtrees (iterative, path halving) */
+static int set_find(int *set, int x) {
+  while (set[x]!=x) {
+    set[x] = set[set[x]];
+    x = set[x];
+  }
+  return x;
+}
+
+/* index list of nodes sorted by saddle height (to be freed) */
+static int *sort_saddles(nodeT *nodes, int n) {
+  int i, *sindex;
+  sindex = (int *) space(n * sizeof(int));
+  for (i=0; i<n; i++) sindex[i]=i;
+  leafs =  nodes;
+  qsort(sindex, n, sizeof(int), cmp_saddle);
+  return sindex;
+}
+
 void PS_tree_plot(nodeT *nodes, int n, char *filename) {
   /* plot tree with leaf-nodes nodes, to file filename (stdout if NULL) */
   FILE *out;
-  int i, k, ll, f=0, *sindex;
-  linkT *chain, *l;
+  int i, k, ll, f=0, *sindex, *set;
+  linkT *chain, *l, **tail;
   int bbox[4] = {72, 144, 522, 700};
   if (filename) {
     out = fopen(filename, "w");
@@ -38,22 +57,33 @@ void PS_tree_plot(nodeT *nodes, int n, char *filename) {
     out = stdout;
 
   /* make index list, sorted by saddle height */
-  sindex = (int *) space(n * sizeof(int));
-  for (i=0; i<n; i++) sindex[i]=i;
-  leafs =  nodes;
-  qsort(sindex, n, sizeof(int), cmp_saddle);
+  sindex = sort_saddles(nodes, n);
 
   /* make order (x-coordinates) of leafs, we use a linked list for this */
   chain = (linkT *) space(n * sizeof(linkT));
+  /* tail of every chain is kept in its union-find root, so we don't walk the chain */
+  set = (int *) space(n * sizeof(int));
+  tail = (linkT **) space(n * sizeof(linkT*));
+  for (i=0; i<n; i++) {
+    set[i] = i;
+    tail[i] = &chain[i];
+  }
   /* start connecting the links of the chain */
   for (i=0; i<n; i++) { /* n-1 merges */
     /* int ff; */
+    int rf, rk;
     k = sindex[i]; f = nodes[k].father; /* ith saddle merges k and f */
     if (f==-1) f=0;
     if (k==f) continue;  /* lowest node doesn't merge */
-    for (l= &chain[f]; l->next!=NULL; l = l->next);
+    rf = set_find(set, f);
+    rk = set_find(set, k);
+    if (rf==rk) continue;
+    l = tail[rf];
     l->next=&chain[k]; /* attach child to chain of father */
+    set[rk] = rf;
+    tail[rf] = tail[rk];
   }
+  free(set); free(tail);
   /* chain[f] now starts the ordered chain, next fill in the num field */
   for (i=0, l= &chain[f]; l!=NULL; l = l->next) l->x = i++;
 
@@ -258,6 +288,108 @@ void PS_tree_plot(nodeT *nodes, int n, char *filename) {
   if (filename) fclose(out);
 }
 
+void newick_tree(nodeT *nodes, int n, char *filename) {
+  /* write tree in Newick format: leaves are minima, internal nodes saddles, branch lengths in kcal/mol */
+  FILE *out;
+  int i, k, f, *sindex, *set, *top, *left, *right, *parent, *stack, sp;
+  float *height;
+  if (filename) {
+    out = fopen(filename, "w");
+    if (!out) {
+      fprintf(stderr, "can't open file %s, aborting Newick output\n", filename);
+      return;
+    }
+  } else
+    out = stdout;
+
+  sindex = sort_saddles(nodes, n);
+
+  /* build binary tree bottom-up: nodes 0..n-1 leaves, n.. internal (saddles) */
+  set = (int *) space(n * sizeof(int));
+  top = (int *) space(n * sizeof(int));         /* topmost tree node of a subtree */
+  left = (int *) space(2*n * sizeof(int));
+  right = (int *) space(2*n * sizeof(int));
+  parent = (int *) space(2*n * sizeof(int));
+  height = (float *) space(2*n * sizeof(float));
+  for (i=0; i<n; i++) {
+    set[i] = top[i] = i;
+    left[i] = right[i] = -1;
+    height[i] = nodes[i].height;
+  }
+  for (i=0; i<2*n; i++) parent[i] = -1;
+  int inner = n;
+  for (i=0; i<n; i++) {
+    int rf, rk;
+    k = sindex[i]; f = nodes[k].father;
+    if (f==-1) f=0;
+    if (k==f) continue;
+    rf = set_find(set, f);
+    rk = set_find(set, k);
+    if (rf==rk) continue;
+    left[inner] = top[rf];
+    right[inner] = top[rk];
+    parent[top[rf]] = parent[top[rk]] = inner;
+    height[inner] = nodes[k].saddle_height;
+    set[rk] = rf;
+    top[rf] = inner++;
+  }
+
+  /* write every tree of the forest (iterative, so deep trees don't overflow the stack) */
+  /* stack entries: node*2 = open node, node*2+1 = close node, -1 = separator */
+  stack = (int *) space(2*inner * sizeof(int));
+  for (i=0; i<n; i++) {
+    if (set[i]!=i) continue;
+    sp = 0;
+    stack[sp++] = top[i]*2;
+    while (sp>0) {
+      int x = stack[--sp];
+      if (x==-1) {
+        fprintf(out, ",");
+        continue;
+      }
+      int node = x/2;
+      if (x%2==0 && left[node]!=-1) {
+        fprintf(out, "(");
+        stack[sp++] = node*2+1;
+        stack[sp++] = right[node]*2;
+        stack[sp++] = -1;
+        stack[sp++] = left[node]*2;
+        continue;
+      }
+      if (x%2==1) fprintf(out, ")");
+      else if (nodes[node].label) fprintf(out, "%s", nodes[node].label);
+      else fprintf(out, "%d", node+1);
+      if (parent[node]!=-1) fprintf(out, ":%.2f", height[parent[node]] - height[node]);
+    }
+    fprintf(out, ";\n");
+  }
+
+  free(stack); free(height); free(parent); free(right); free(left); free(top); free(set); free(sindex);
+  if (filename) fclose(out);
+}
+
+void json_tree(nodeT *nodes, int n, char *filename) {
+  /* write tree as compact JSON list of nodes (1-based numbers, father 0 = root) */
+  FILE *out;
+  int i;
+  if (filename) {
+    out = fopen(filename, "w");
+    if (!out) {
+      fprintf(stderr, "can't open file %s, aborting JSON output\n", filename);
+      return;
+    }
+  } else
+    out = stdout;
+
+  fprintf(out, "{\"num\":%d,\"fields\":[\"id\",\"energy\",\"father\",\"saddle\",\"findpath\"],\"nodes\":[\n", n);
+  for (i=0; i<n; i++) {
+    fprintf(out, "[%d,%.2f,%d,%.2f,%d]%s\n", i+1, nodes[i].height, nodes[i].father+1, nodes[i].saddle_height,
+            nodes[i].color>0.0?1:0, i<n-1?",":"");
+  }
+  fprintf(out, "]}\n");
+  if (filename) fclose(out);
+}
+
 static int cmp_saddle(const void *A, const void *B) {
   float diff;
   diff = leafs[*((int *)A)].saddle_height -
@@ -18,5 +18,11 @@ typedef struct {
 // generate barrier tree (from n nodes to filename) (stolen from barriers)
 void PS_tree_plot(nodeT *nodes, int n, char *filename);
 
+// write the tree in Newick format (leaves = minima, branch lengths = energy differences)
+void newick_tree(nodeT *nodes, int n, char *filename);
+
+// write the tree as compact JSON node list
+void json_tree(nodeT *nodes, int n, char *filename);
+
 #endif
 /* End of file */